@@ -0,0 +1,493 @@
+/*  Simple mines game with solver.
+    Copyright (C) 2015 Igor Shevchenko
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//
+// Headless batch runner: plays many games with the solver, several at a time,
+// and reports per-game and aggregate statistics.
+//
+// Usage: miner_batch [--rows N] [--cols N] [--mines N] [--seeds FIRST:LAST]
+//                    [--threads N] [--solver NAME[,NAME...]]
+//                    [--format json|csv] [--out FILE] [--trace DIR]
+//
+// Each game starts by opening the empty cell closest to the board's center,
+// which opens its whole zero region as a click in the game does.
+// Whenever the solver gets stuck, the cell least likely to be mined is
+// opened; a game is lost when such a guess hits a mine.
+//
+// lp_solves counts the LPs a backend solved, or its SAT solves for sat.
+//
+// With several solvers, every seed is played by each of them in turn on the
+// same thread, and each one is compared with the first: games agree when
+// they end with the same board, and speedup is the ratio of game times.
+// Wall time of the batch is then shared by all solvers.
+//
+// With --trace, each game is recorded to DIR/<solver>-<seed>.trace, for
+// miner_replay.
+//
+
+#include <chrono>
+
+#include "board.h"
+#include "solver_registry.h"
+
+namespace miner {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BatchConfig {
+    size_t rows{16};
+    size_t cols{30};
+    size_t mines_nr{99};
+    long first_seed{1};
+    long last_seed{100};
+    size_t threads{};
+    std::vector<const SolverRegistry::Backend*> backends;
+    bool csv{};
+    std::string out;
+    std::string trace_dir;
+};
+
+enum class Outcome : uint8_t {
+    kWon,
+    kLost,  // a guess hit a mine
+    kError, // solver deduced a wrong cell
+};
+
+const char* to_string(Outcome o) {
+    switch(o) {
+    case Outcome::kWon: return "won";
+    case Outcome::kLost: return "lost";
+    case Outcome::kError: return "error";
+    }
+    return "";
+}
+
+struct GameStats {
+    long seed{};
+    Outcome outcome{};
+    size_t cells_solved{}; // resolved by solver, not by opening cells or their zero regions
+    size_t guesses{};      // times solver got stuck, not counting the first move
+    size_t lp_solves{};
+    PoiScheduler::Stats pois;
+    uint64_t board_hash{}; // of the final board, to compare solvers
+    double wall_ms{};
+};
+
+
+// FNV-1a over cell states
+uint64_t board_hash(const GameBoard& board) {
+    uint64_t rv = 14695981039346656037ull;
+    for(size_t row = 0; row < board.rows(); ++row)
+        for(size_t col = 0; col < board.cols(); ++col)
+            rv = (rv ^ uint64_t(board.at({row, col}))) * 1099511628211ull;
+    return rv;
+}
+
+
+// Empty cell closest to the center, or any safe one if there are no empty
+// cells.
+Location first_move(const Field& field) {
+    Location center{field.rows() / 2, field.cols() / 2}, rv;
+    size_t best = size_t(-1);
+    for(size_t row = 0; row < field.rows(); ++row)
+        for(size_t col = 0; col < field.cols(); ++col) {
+            Location l{row, col};
+            if (field.is_mined(l))
+                continue;
+
+            size_t dist = std::max(row > center.row ? row - center.row : center.row - row,
+                                   col > center.col ? col - center.col : center.col - col);
+            if (field.nearby_mines_nr(l))
+                dist += field.rows() + field.cols();
+            if (dist < best) {
+                best = dist;
+                rv = l;
+            }
+        }
+
+    return rv;
+}
+
+
+// Unknown cell least likely to be mined.
+bool pick_guess(Solver& solver, const GameBoard& board, Location& rv) {
+    ProbabilityEngine::Result result;
+    if (!solver.getProbabilities(result))
+        return false;
+
+    double best = 2;
+    for(auto& p: result.cells)
+        if (p.second < best or (p.second == best and (p.first.row < rv.row or
+                                                       (p.first.row == rv.row and p.first.col < rv.col)))) {
+            best = p.second;
+            rv = p.first;
+        }
+
+    if (result.other < best) {
+        for(size_t row = 0; row < board.rows(); ++row)
+            for(size_t col = 0; col < board.cols(); ++col) {
+                Location l{row, col};
+                if (board.at(l) == GameBoard::CellInfo::Unknown and !result.cells.count(l)) {
+                    rv = l;
+                    return true;
+                }
+            }
+    }
+
+    return best <= 1;
+}
+
+
+GameStats play(const BatchConfig& cfg, const SolverRegistry::Backend& backend, long seed) {
+    GameStats rv;
+    rv.seed = seed;
+    auto t0 = Clock::now();
+
+    auto field = std::make_shared<Field>();
+    field->gen_random(cfg.rows, cfg.cols, cfg.mines_nr, seed);
+    auto board = std::make_shared<GameBoard>();
+    board->set_field(field);
+
+    auto solver = backend.create(board);
+    solver->setResultHandler([](Solver::FeedbackState, Location, size_t){});
+    SolverTracePtr trace;
+    if (!cfg.trace_dir.empty()) {
+        auto path = cfg.trace_dir + "/" + backend.name + "-" + std::to_string(seed) + ".trace";
+        trace = std::make_shared<SolverTrace>(path, *field, backend.name);
+        solver->setTrace(trace);
+    }
+
+    auto safe_nr = cfg.rows * cfg.cols - field->mines_nr();
+    size_t opened{};
+    std::vector<Location> border;
+    auto l = first_move(*field);
+    while(true) {
+        if (trace)
+            trace->record(field->is_mined(l) ? SolverTrace::Event::kExplode : SolverTrace::Event::kOpen, l);
+        if (field->is_mined(l)) {
+            board->mark_exploded(l);
+            board->set_game_lost();
+            rv.outcome = Outcome::kLost;
+            break;
+        }
+
+        auto uncovered_nr = board->uncovered_nr();
+        board->uncovered_safe(l, field->nearby_mines_nr(l));
+        if (board->at(l) == GameBoard::CellInfo::N0) {
+            border.clear();
+            board->open_zeros(l, border);
+            for(auto& c: border)
+                solver->addPoi(c);
+        } else {
+            solver->addPoi(l);
+        }
+        opened += board->uncovered_nr() - uncovered_nr;
+        if (!solver->solveQueued()) {
+            rv.outcome = Outcome::kError;
+            break;
+        }
+
+        if (board->uncovered_nr() == safe_nr) {
+            rv.outcome = Outcome::kWon;
+            break;
+        }
+
+        if (!pick_guess(*solver, *board, l)) {
+            rv.outcome = Outcome::kError;
+            break;
+        }
+        ++rv.guesses;
+    }
+
+    rv.cells_solved = board->uncovered_nr() + board->mines_marked() - opened;
+    rv.lp_solves = solver->lpSolves();
+    rv.pois = solver->poiStats();
+    rv.board_hash = board_hash(*board);
+    rv.wall_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    return rv;
+}
+
+
+// Games of each backend, by seed.
+std::vector<std::vector<GameStats>> play_all(const BatchConfig& cfg) {
+    size_t games_nr = cfg.last_seed - cfg.first_seed + 1;
+    std::vector<std::vector<GameStats>> rv(cfg.backends.size(), std::vector<GameStats>(games_nr));
+    std::atomic<size_t> next{};
+
+    auto worker = [&] {
+        for(size_t i = next++; i < games_nr; i = next++)
+            for(size_t b = 0; b < rv.size(); ++b)
+                rv[b][i] = play(cfg, *cfg.backends[b], cfg.first_seed + i);
+    };
+
+    std::vector<std::thread> threads;
+    for(size_t i = 1; i < std::min(cfg.threads, games_nr); ++i)
+        threads.emplace_back(worker);
+    worker();
+    for(auto& t: threads)
+        t.join();
+
+    return rv;
+}
+
+
+struct Summary {
+    size_t games{};
+    size_t won{};
+    size_t lost{};
+    size_t errors{};
+    size_t stalled{}; // games which needed at least one guess
+    size_t cells_solved{};
+    size_t guesses{};
+    size_t lp_solves{};
+    PoiScheduler::Stats pois;
+    double game_ms{}; // sum of per-game times
+    double wall_ms{};
+
+    double rate(size_t v) const { return games ? double(v) / games : 0; }
+    double mean(double v) const { return games ? v / games : 0; }
+};
+
+
+Summary summarize(const std::vector<GameStats>& games, double wall_ms) {
+    Summary rv;
+    rv.games = games.size();
+    rv.wall_ms = wall_ms;
+    for(auto& g: games) {
+        rv.won += g.outcome == Outcome::kWon;
+        rv.lost += g.outcome == Outcome::kLost;
+        rv.errors += g.outcome == Outcome::kError;
+        rv.stalled += g.guesses > 0;
+        rv.cells_solved += g.cells_solved;
+        rv.guesses += g.guesses;
+        rv.lp_solves += g.lp_solves;
+        rv.pois.enqueued += g.pois.enqueued;
+        rv.pois.deduplicated += g.pois.deduplicated;
+        rv.pois.solved += g.pois.solved;
+        rv.game_ms += g.wall_ms;
+    }
+    return rv;
+}
+
+
+// Games of a backend against the same seeds played by the baseline.
+struct Comparison {
+    size_t agreed{};
+    std::vector<long> disagreed; // seeds
+    double speedup{};            // baseline's game time over backend's
+
+    Comparison(const std::vector<GameStats>& baseline, const Summary& baseline_summary,
+               const std::vector<GameStats>& games, const Summary& summary) {
+        for(size_t i = 0; i < games.size(); ++i)
+            if (games[i].outcome == baseline[i].outcome
+                and games[i].board_hash == baseline[i].board_hash)
+                ++agreed;
+            else
+                disagreed.push_back(games[i].seed);
+        speedup = summary.game_ms > 0 ? baseline_summary.game_ms / summary.game_ms : 0;
+    }
+};
+
+
+void write_json(FILE* f, const BatchConfig& cfg,
+                const std::vector<std::vector<GameStats>>& runs,
+                const std::vector<Summary>& summaries) {
+    fprintf(f, "{\n  \"config\": {\"rows\": %zu, \"cols\": %zu, \"mines\": %zu, "
+            "\"first_seed\": %ld, \"last_seed\": %ld, \"threads\": %zu, \"solvers\": [",
+            cfg.rows, cfg.cols, cfg.mines_nr, cfg.first_seed, cfg.last_seed, cfg.threads);
+    for(size_t b = 0; b < runs.size(); ++b)
+        fprintf(f, "%s\"%s\"", b ? ", " : "", cfg.backends[b]->name);
+    fprintf(f, "]},\n");
+
+    fprintf(f, "  \"runs\": [\n");
+    for(size_t b = 0; b < runs.size(); ++b) {
+        auto& games = runs[b];
+        auto& s = summaries[b];
+        fprintf(f, "    {\"solver\": \"%s\",\n     \"games\": [\n", cfg.backends[b]->name);
+        for(size_t i = 0; i < games.size(); ++i) {
+            auto& g = games[i];
+            fprintf(f, "      {\"seed\": %ld, \"outcome\": \"%s\", \"cells_solved\": %zu, "
+                    "\"guesses\": %zu, \"lp_solves\": %zu, \"pois_enqueued\": %zu, "
+                    "\"pois_deduplicated\": %zu, \"pois_solved\": %zu, \"wall_ms\": %.3f}%s\n",
+                    g.seed, to_string(g.outcome), g.cells_solved, g.guesses, g.lp_solves,
+                    g.pois.enqueued, g.pois.deduplicated, g.pois.solved,
+                    g.wall_ms, i + 1 < games.size() ? "," : "");
+        }
+        fprintf(f, "     ],\n");
+
+        fprintf(f, "     \"summary\": {\"games\": %zu, \"won\": %zu, \"lost\": %zu, \"errors\": %zu, "
+                "\"win_rate\": %.4f, \"loss_rate\": %.4f, \"stall_rate\": %.4f, "
+                "\"cells_solved\": %zu, \"guesses\": %zu, \"lp_solves\": %zu, "
+                "\"pois_enqueued\": %zu, \"pois_deduplicated\": %zu, \"pois_solved\": %zu, "
+                "\"mean_game_ms\": %.3f, \"wall_ms\": %.3f}}%s\n",
+                s.games, s.won, s.lost, s.errors,
+                s.rate(s.won), s.rate(s.lost), s.rate(s.stalled),
+                s.cells_solved, s.guesses, s.lp_solves,
+                s.pois.enqueued, s.pois.deduplicated, s.pois.solved,
+                s.mean(s.game_ms), s.wall_ms, b + 1 < runs.size() ? "," : "");
+    }
+    fprintf(f, "  ],\n");
+
+    fprintf(f, "  \"comparisons\": [");
+    for(size_t b = 1; b < runs.size(); ++b) {
+        Comparison c{runs[0], summaries[0], runs[b], summaries[b]};
+        fprintf(f, "%s\n    {\"baseline\": \"%s\", \"solver\": \"%s\", \"agreed\": %zu, "
+                "\"disagreed\": %zu, \"speedup\": %.3f, \"disagreed_seeds\": [",
+                b > 1 ? "," : "", cfg.backends[0]->name, cfg.backends[b]->name,
+                c.agreed, c.disagreed.size(), c.speedup);
+        for(size_t i = 0; i < c.disagreed.size(); ++i)
+            fprintf(f, "%s%ld", i ? ", " : "", c.disagreed[i]);
+        fprintf(f, "]}");
+    }
+    fprintf(f, "%s]\n}\n", runs.size() > 1 ? "\n  " : "");
+}
+
+
+// Per-game table, then a blank line and a summary table with a row per
+// solver; with several solvers, another blank line and a comparison table.
+void write_csv(FILE* f, const BatchConfig& cfg,
+               const std::vector<std::vector<GameStats>>& runs,
+               const std::vector<Summary>& summaries) {
+    fprintf(f, "solver,seed,outcome,cells_solved,guesses,lp_solves,"
+            "pois_enqueued,pois_deduplicated,pois_solved,wall_ms\n");
+    for(size_t b = 0; b < runs.size(); ++b)
+        for(auto& g: runs[b])
+            fprintf(f, "%s,%ld,%s,%zu,%zu,%zu,%zu,%zu,%zu,%.3f\n",
+                    cfg.backends[b]->name, g.seed, to_string(g.outcome),
+                    g.cells_solved, g.guesses, g.lp_solves,
+                    g.pois.enqueued, g.pois.deduplicated, g.pois.solved, g.wall_ms);
+
+    fprintf(f, "\nsolver,games,won,lost,errors,win_rate,loss_rate,stall_rate,cells_solved,guesses,"
+            "lp_solves,pois_enqueued,pois_deduplicated,pois_solved,mean_game_ms,wall_ms\n");
+    for(size_t b = 0; b < runs.size(); ++b) {
+        auto& s = summaries[b];
+        fprintf(f, "%s,%zu,%zu,%zu,%zu,%.4f,%.4f,%.4f,%zu,%zu,%zu,%zu,%zu,%zu,%.3f,%.3f\n",
+                cfg.backends[b]->name, s.games, s.won, s.lost, s.errors,
+                s.rate(s.won), s.rate(s.lost), s.rate(s.stalled),
+                s.cells_solved, s.guesses, s.lp_solves,
+                s.pois.enqueued, s.pois.deduplicated, s.pois.solved,
+                s.mean(s.game_ms), s.wall_ms);
+    }
+
+    if (runs.size() < 2)
+        return;
+
+    fprintf(f, "\nbaseline,solver,agreed,disagreed,speedup,disagreed_seeds\n");
+    for(size_t b = 1; b < runs.size(); ++b) {
+        Comparison c{runs[0], summaries[0], runs[b], summaries[b]};
+        fprintf(f, "%s,%s,%zu,%zu,%.3f,", cfg.backends[0]->name, cfg.backends[b]->name,
+                c.agreed, c.disagreed.size(), c.speedup);
+        for(size_t i = 0; i < c.disagreed.size(); ++i)
+            fprintf(f, "%s%ld", i ? " " : "", c.disagreed[i]);
+        fprintf(f, "\n");
+    }
+}
+
+
+void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [--rows N] [--cols N] [--mines N] [--seeds FIRST:LAST]\n"
+            "          [--threads N] [--solver NAME[,NAME...]]\n"
+            "          [--format json|csv] [--out FILE] [--trace DIR]\n"
+            "solvers: %s\n", argv0, SolverRegistry::names().data());
+    exit(2);
+}
+
+
+BatchConfig parse_args(int argc, char** argv) {
+    BatchConfig rv;
+    rv.threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 == argc)
+            usage(argv[0]);
+        const char* v = argv[++i];
+
+        if (arg == "--rows")
+            rv.rows = strtoul(v, nullptr, 10);
+        else if (arg == "--cols")
+            rv.cols = strtoul(v, nullptr, 10);
+        else if (arg == "--mines")
+            rv.mines_nr = strtoul(v, nullptr, 10);
+        else if (arg == "--threads")
+            rv.threads = std::max(1ul, strtoul(v, nullptr, 10));
+        else if (arg == "--solver") {
+            std::istringstream names{v};
+            std::string name;
+            while(std::getline(names, name, ','))
+                if (auto b = SolverRegistry::find(name))
+                    rv.backends.push_back(b);
+                else
+                    usage(argv[0]);
+        }
+        else if (arg == "--out")
+            rv.out = v;
+        else if (arg == "--trace")
+            rv.trace_dir = v;
+        else if (arg == "--format" and (v == std::string("json") or v == std::string("csv")))
+            rv.csv = v == std::string("csv");
+        else if (arg == "--seeds") {
+            char* end{};
+            rv.first_seed = rv.last_seed = strtol(v, &end, 10);
+            if (*end == ':')
+                rv.last_seed = strtol(end + 1, &end, 10);
+            if (*end)
+                usage(argv[0]);
+        }
+        else
+            usage(argv[0]);
+    }
+
+    if (!rv.rows or !rv.cols or rv.mines_nr >= rv.rows * rv.cols
+        or rv.last_seed < rv.first_seed)
+        usage(argv[0]);
+    if (rv.backends.empty())
+        rv.backends.push_back(&SolverRegistry::preferred());
+    return rv;
+}
+
+} // namespace
+} // namespace miner
+
+
+int main(int argc, char** argv) {
+    auto cfg = miner::parse_args(argc, argv);
+
+    auto t0 = miner::Clock::now();
+    auto runs = miner::play_all(cfg);
+    auto wall_ms = std::chrono::duration<double, std::milli>(miner::Clock::now() - t0).count();
+    std::vector<miner::Summary> summaries;
+    for(auto& games: runs)
+        summaries.push_back(miner::summarize(games, wall_ms));
+
+    FILE* f = cfg.out.empty() ? stdout : fopen(cfg.out.data(), "w");
+    if (!f) {
+        perror(cfg.out.data());
+        return 1;
+    }
+
+    if (cfg.csv)
+        miner::write_csv(f, cfg, runs, summaries);
+    else
+        miner::write_json(f, cfg, runs, summaries);
+
+    if (f != stdout)
+        fclose(f);
+    return 0;
+}
@@ -0,0 +1,557 @@
+/*  Simple mines game with solver.
+    Copyright (C) 2015 Igor Shevchenko
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//
+// Headless micro-benchmarks for field, board and solver hot paths.
+//
+// Usage: miner_bench [name-filter] [min-time-ms]
+//
+
+#include <chrono>
+
+#include "board.h"
+#include "parallel_solver.h"
+#include "sat_solver.h"
+#include "simplex_solver.h"
+#include "solver.h"
+
+#if ENABLE_GLPK_SOLVER
+#include "glpk_region_model.h"
+#include "glpk_solver.h"
+#endif
+
+#if ENABLE_SOPLEX_SOLVER
+#include "soplex_solver.h"
+#endif
+
+namespace miner {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchConfig {
+    size_t rows;
+    size_t cols;
+    double density; // mines per cell
+    long seed;
+
+    size_t mines_nr() const { return rows * cols * density; }
+};
+
+const BenchConfig kConfigs[] = {
+    {16, 30, 0.206, 1},     // "expert"
+    {256, 256, 0.15, 2},
+    {1024, 1024, 0.20, 3},
+    {2048, 2048, 0.10, 4},
+};
+
+std::string g_filter;
+double g_min_time_ms = 200;
+volatile size_t g_sink; // keeps optimizer from dropping benchmarked calls
+
+
+// Runs f(ops) with a growing number of ops until the measured time exceeds the
+// minimal run time, then prints per-op and per-cell throughput. f returns the
+// number of nanoseconds it spent in the timed section, so that it can exclude
+// setup work (e.g. board resets). Returns false if the name filter skipped it.
+template<class F>
+bool run(const char* name, const BenchConfig& cfg, size_t cells_per_op, F&& f) {
+    if (!g_filter.empty() and std::string(name).find(g_filter) == std::string::npos)
+        return false;
+
+    size_t ops = 1;
+    double ns{};
+    while(true) {
+        ns = f(ops);
+        if (ns >= g_min_time_ms * 1e6 or ops >= (size_t(1) << 40))
+            break;
+
+        // aim a bit past the target to avoid too many calibration rounds
+        double scale = ns > 0 ? g_min_time_ms * 1e6 * 1.2 / ns : 100;
+        ops = std::max(ops + 1, size_t(ops * std::min(scale, 100.)));
+    }
+
+    char board[32];
+    snprintf(board, sizeof(board), "%zux%zu", cfg.rows, cfg.cols);
+    printf("%-32s %-10s %6.3f %12zu %14.1f %14.4g\n",
+           name, board, cfg.density, ops, ns / ops,
+           double(cells_per_op) * ops / (ns * 1e-9));
+    fflush(stdout);
+    return true;
+}
+
+
+template<class F>
+double timed(F&& f) {
+    auto t0 = Clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+}
+
+
+// Builds a board with roughly half of the safe cells uncovered, which gives a
+// dense frontier with lots of partially constrained cells.
+GameBoardPtr make_board(const BenchConfig& cfg, double uncovered = 0.5) {
+    auto field = std::make_shared<Field>();
+    field->gen_random(cfg.rows, cfg.cols, cfg.mines_nr(), cfg.seed);
+
+    auto board = std::make_shared<GameBoard>();
+    board->set_field(field);
+
+    srand48(cfg.seed + 1);
+    for(size_t row = 0; row < cfg.rows; ++row)
+        for(size_t col = 0; col < cfg.cols; ++col) {
+            Location l{row, col};
+            if (!field->is_mined(l) and drand48() < uncovered)
+                board->uncovered_safe(l, field->nearby_mines_nr(l));
+        }
+
+    return board;
+}
+
+
+class BenchSolver : public
+#if ENABLE_GLPK_SOLVER
+    GlpkSolver
+#else
+    Solver
+#endif
+{
+public:
+#if ENABLE_GLPK_SOLVER
+    using GlpkSolver::GlpkSolver;
+    using GlpkSolver::doPoi;
+#else
+    using Solver::Solver;
+    bool doPoi(Location) override { return true; }
+#endif
+    using Solver::NeighborhoodInfo;
+    using Solver::getNeighborhoodInfo;
+    using Solver::collectComponents;
+};
+
+
+// Exposes doPoi() of an LP backend.
+template<class S>
+class BenchLpSolver : public S {
+public:
+    using S::S;
+    using S::doPoi;
+};
+
+
+// What a pass of a backend took, for the report line after it.
+struct PassCounts {
+    size_t solves{};
+    size_t work{};
+};
+
+template<class S>
+PassCounts pass_counts(const S& s) {
+    return {s.stats().lp_solves, s.stats().simplex_iterations};
+}
+
+PassCounts pass_counts(const SatSolver& s) {
+    return {s.stats().sat_solves, s.stats().conflicts};
+}
+
+
+// Passes over POIs with a fresh board and solver each, like
+// GlpkSolver::doPoi below. "solves" and "work" name what pass_counts()
+// returns for the backend.
+template<class S>
+void bench_passes(const char* name, const BenchConfig& cfg, const GameBoard& pristine,
+                  const GameBoardPtr& board, const std::vector<Location>& pois,
+                  size_t avg_constraints, const char* solves = "LP solves",
+                  const char* work = "simplex iterations") {
+    PassCounts total;
+    double total_ns{};
+    run(name, cfg, avg_constraints, [&](size_t ops) {
+        double ns{};
+        std::unique_ptr<BenchLpSolver<S>> s;
+        total = {};
+        auto account = [&] {
+            if (s) {
+                auto counts = pass_counts(static_cast<const S&>(*s));
+                total.solves += counts.solves;
+                total.work += counts.work;
+            }
+        };
+        for(size_t i = 0; i < ops; ++i) {
+            if (i % pois.size() == 0) {
+                account();
+                *board = pristine;
+                s.reset(new BenchLpSolver<S>{board});
+                s->setResultHandler([](Solver::FeedbackState, Location, size_t){});
+            }
+            ns += timed([&] { s->doPoi(pois[i % pois.size()]); });
+        }
+        account();
+        total_ns = ns;
+        return ns;
+    });
+    if (total.solves)
+        printf("  %zu %s, %.2f %s and %.1f us of doPoi() per solve\n",
+               total.solves, solves, double(total.work) / total.solves, work,
+               total_ns / total.solves / 1000);
+}
+
+
+// Uncovered cells with at least one unknown neighbor, i.e. the cells solver
+// gets as POIs.
+std::vector<Location> frontier(BenchSolver& solver, const GameBoard& board, size_t max_nr) {
+    std::vector<Location> rv;
+    for(size_t row = 0; row < board.rows(); ++row)
+        for(size_t col = 0; col < board.cols(); ++col) {
+            Location l{row, col};
+            if (board.is_uncovered(l) and solver.getNeighborhoodInfo(l).nr)
+                rv.push_back(l);
+        }
+
+    // keep an evenly spaced subset
+    if (rv.size() > max_nr) {
+        std::vector<Location> sub;
+        for(size_t i = 0; i < max_nr; ++i)
+            sub.push_back(rv[i * rv.size() / max_nr]);
+        rv.swap(sub);
+    }
+
+    return rv;
+}
+
+
+void bench_field(const BenchConfig& cfg) {
+    run("Field::gen_random", cfg, cfg.rows * cfg.cols, [&](size_t ops) {
+        Field f;
+        return timed([&] {
+            for(size_t i = 0; i < ops; ++i)
+                f.gen_random(cfg.rows, cfg.cols, cfg.mines_nr(), cfg.seed + i);
+        });
+    });
+
+    Field field;
+    field.gen_random(cfg.rows, cfg.cols, cfg.mines_nr(), cfg.seed);
+
+    run("Field::nearby_mines_nr", cfg, 1, [&](size_t ops) {
+        size_t sum{};
+        auto ns = timed([&] {
+            size_t row{}, col{};
+            for(size_t i = 0; i < ops; ++i) {
+                sum += field.nearby_mines_nr({row, col});
+                if (++col == cfg.cols) {
+                    col = 0;
+                    if (++row == cfg.rows)
+                        row = 0;
+                }
+            }
+        });
+        g_sink = sum;
+        return ns;
+    });
+}
+
+
+void bench_board(const BenchConfig& cfg) {
+    auto board = make_board(cfg);
+
+    run("CellNeighborhoodIterator()", cfg, 1, [&](size_t ops) {
+        size_t sum{};
+        auto ns = timed([&] {
+            size_t row{}, col{};
+            for(size_t i = 0; i < ops; ++i) {
+                CellNeighborhoodIterator it{board.get(), {row, col}};
+                sum += bool(it);
+                if (++col == cfg.cols) {
+                    col = 0;
+                    if (++row == cfg.rows)
+                        row = 0;
+                }
+            }
+        });
+        g_sink = sum;
+        return ns;
+    });
+
+    run("GameBoard::frontier", cfg, cfg.rows * cfg.cols, [&](size_t ops) {
+        std::vector<Location> cells;
+        return timed([&] {
+            for(size_t i = 0; i < ops; ++i) {
+                cells.clear();
+                board->frontier(cells);
+            }
+        });
+    });
+}
+
+
+void bench_solver(const BenchConfig& cfg) {
+    auto pristine = make_board(cfg);
+    auto board = std::make_shared<GameBoard>(*pristine);
+    BenchSolver solver{board};
+    solver.setResultHandler([](Solver::FeedbackState, Location, size_t){});
+    auto pois = frontier(solver, *board, 4096);
+    if (pois.empty())
+        return;
+
+    run("Solver::getNeighborhoodInfo", cfg, 1, [&](size_t ops) {
+        size_t sum{};
+        auto ns = timed([&] {
+            for(size_t i = 0; i < ops; ++i)
+                sum += solver.getNeighborhoodInfo(pois[i % pois.size()]).nr;
+        });
+        g_sink = sum;
+        return ns;
+    });
+
+    // constraints per POI, used as "cells" for component-based benchmarks
+    std::vector<std::vector<Location>> components;
+    std::vector<std::vector<Location>> first_components;
+    size_t constraints_nr{};
+    for(auto& poi: pois) {
+        solver.collectComponents(poi, components);
+        first_components.push_back(components.empty() ? std::vector<Location>{} : components[0]);
+        for(auto& c: components)
+            constraints_nr += c.size();
+    }
+    size_t avg_constraints = std::max<size_t>(1, constraints_nr / pois.size());
+
+    run("Solver::collectComponents", cfg, avg_constraints, [&](size_t ops) {
+        size_t sum{};
+        auto ns = timed([&] {
+            for(size_t i = 0; i < ops; ++i) {
+                solver.collectComponents(pois[i % pois.size()], components);
+                sum += components.size();
+            }
+        });
+        g_sink = sum;
+        return ns;
+    });
+
+    {
+        ProbabilityEngine::Result result;
+        // the first stall enumerates every component
+        run("Solver::getProbabilities/first", cfg, cfg.rows * cfg.cols, [&](size_t ops) {
+            double ns{};
+            size_t sum{};
+            for(size_t i = 0; i < ops; ++i) {
+                BenchSolver s{board};
+                ns += timed([&] {
+                    s.getProbabilities(result);
+                });
+                sum += result.cells.size();
+            }
+            g_sink = sum;
+            return ns;
+        });
+
+        // later ones only what changed, which here is nothing
+        bool warm{};
+        bool ran = run("Solver::getProbabilities", cfg, cfg.rows * cfg.cols, [&](size_t ops) {
+            if (!warm) {
+                solver.getProbabilities(result);
+                warm = true;
+            }
+            size_t sum{};
+            auto ns = timed([&] {
+                for(size_t i = 0; i < ops; ++i) {
+                    solver.getProbabilities(result);
+                    sum += result.cells.size();
+                }
+            });
+            g_sink = sum;
+            return ns;
+        });
+        if (ran)
+            printf("  %zu constrained cells, %s\n", result.cells.size(),
+                   result.exact ? "exact" : "approximate");
+    }
+
+#if ENABLE_GLPK_SOLVER
+    // cold sync: builds a component's model from scratch
+    run("GlpkRegionModel::sync", cfg, avg_constraints, [&](size_t ops) {
+        size_t sum{};
+        std::vector<BenchSolver::NeighborhoodInfo> infos;
+        std::vector<Location> removed;
+        GlpkRegionModel::SyncStats stats;
+        auto ns = timed([&] {
+            for(size_t i = 0; i < ops; ++i) {
+                GlpkRegionModel model{board->cols()};
+                auto& constraints = first_components[i % pois.size()];
+                infos.clear();
+                for(auto& l: constraints)
+                    infos.push_back(solver.getNeighborhoodInfo(l));
+                model.sync(constraints, infos, removed, stats);
+                sum += model.vars().size();
+            }
+        });
+        g_sink = sum;
+        return ns;
+    });
+
+    size_t lp_solves{}, iterations{}, skipped{};
+    run("GlpkSolver::doPoi", cfg, avg_constraints, [&](size_t ops) {
+        double ns{};
+        std::unique_ptr<BenchSolver> s;
+        lp_solves = iterations = skipped = 0;
+        auto account = [&] {
+            if (s) {
+                lp_solves += s->stats().lp_solves;
+                iterations += s->stats().simplex_iterations;
+                skipped += s->stats().probes_skipped;
+            }
+        };
+        for(size_t i = 0; i < ops; ++i) {
+            // each pass over POIs starts from the same position
+            if (i % pois.size() == 0) {
+                account();
+                *board = *pristine;
+                s.reset(new BenchSolver{board});
+                s->setResultHandler([](Solver::FeedbackState, Location, size_t){});
+            }
+            ns += timed([&] { s->doPoi(pois[i % pois.size()]); });
+        }
+        account();
+        return ns;
+    });
+    if (lp_solves)
+        printf("  %zu LP solves, %.2f simplex iterations per solve, %zu probes skipped\n",
+               lp_solves, double(iterations) / lp_solves, skipped);
+#endif
+
+    // same passes over POIs with other backends
+    bench_passes<SimplexSolver>("SimplexSolver::doPoi", cfg, *pristine, board, pois, avg_constraints);
+    bench_passes<SatSolver>("SatSolver::doPoi", cfg, *pristine, board, pois, avg_constraints,
+                            "SAT solves", "conflicts");
+#if ENABLE_SOPLEX_SOLVER
+    bench_passes<SoplexSolver>("SoplexSolver::doPoi", cfg, *pristine, board, pois, avg_constraints);
+#endif
+}
+
+
+#if ENABLE_GLPK_SOLVER
+class BenchParallelSolver : public ParallelSolver {
+public:
+    using ParallelSolver::ParallelSolver;
+    using ParallelSolver::doPoi;
+};
+
+
+// Solves from every frontier POI until nothing is left to deduce, with a
+// growing number of workers.
+void bench_parallel(const BenchConfig& cfg) {
+    auto pristine = make_board(cfg);
+    if (!ParallelSolver::worthIt(*pristine))
+        return;
+
+    auto board = std::make_shared<GameBoard>(*pristine);
+    BenchSolver solver{board};
+    auto pois = frontier(solver, *board, size_t(-1));
+    if (pois.empty())
+        return;
+
+    auto max_workers = std::max(1u, std::thread::hardware_concurrency());
+    for(size_t workers = 1; workers <= max_workers; workers *= 2) {
+        auto name = "ParallelSolver/" + std::to_string(workers);
+        size_t resolved{};
+        run(name.data(), cfg, pristine->left_nr(), [&](size_t ops) {
+            double ns{};
+            for(size_t i = 0; i < ops; ++i) {
+                *board = *pristine;
+                BenchParallelSolver s{
+                    board,
+                    [](GameBoardPtr b) { return std::unique_ptr<Solver>(new GlpkSolver{b}); },
+                    workers};
+                s.setResultHandler([](Solver::FeedbackState, Location, size_t){});
+                ns += timed([&] {
+                    for(size_t k = 1; k < pois.size(); ++k)
+                        s.addPoi(pois[k]);
+                    s.doPoi(pois[0]);
+                });
+                resolved = pristine->left_nr() - board->left_nr();
+            }
+            return ns;
+        });
+        printf("  %zu of %zu unknown cells resolved\n", resolved, pristine->left_nr());
+    }
+}
+
+
+// Few unknown cells left: passes over all POIs with and without global mode.
+void bench_endgame(const BenchConfig& cfg) {
+    auto pristine = make_board(cfg, 0.97);
+    auto board = std::make_shared<GameBoard>(*pristine);
+    BenchSolver solver{board};
+    auto pois = frontier(solver, *board, 4096);
+    if (pois.empty())
+        return;
+
+    for(auto threshold: {size_t(0), GlpkSolver::kGlobalThreshold}) {
+        size_t passes{}, resolved{}, global_resolved{};
+        run(threshold ? "GlpkSolver::doPoi/endgame+global" : "GlpkSolver::doPoi/endgame",
+            cfg, pois.size(), [&](size_t ops) {
+            double ns{};
+            passes = resolved = global_resolved = 0;
+            for(size_t i = 0; i < ops; ++i) {
+                *board = *pristine;
+                BenchSolver s{board};
+                s.setResultHandler([](Solver::FeedbackState, Location, size_t){});
+                s.setGlobalThreshold(threshold);
+                ns += timed([&] {
+                    for(auto& poi: pois)
+                        s.doPoi(poi);
+                });
+                ++passes;
+                resolved += pristine->left_nr() - board->left_nr();
+                global_resolved += s.globalStats().resolved;
+            }
+            return ns;
+        });
+        if (passes)
+            printf("  %zu of %zu unknown cells resolved per pass, %zu by global mode\n",
+                   resolved / passes, pristine->left_nr(), global_resolved / passes);
+    }
+}
+#endif
+
+} // namespace
+} // namespace miner
+
+
+int main(int argc, char** argv) {
+    if (argc > 1)
+        miner::g_filter = argv[1];
+    if (argc > 2)
+        miner::g_min_time_ms = atof(argv[2]);
+
+#ifndef __OPTIMIZE__
+    printf("WARNING: built without optimization, numbers are not representative\n");
+#endif
+
+    printf("%-32s %-10s %6s %12s %14s %14s\n",
+           "benchmark", "board", "mines", "ops", "ns/op", "cells/sec");
+    for(auto& cfg: miner::kConfigs) {
+        miner::bench_field(cfg);
+        miner::bench_board(cfg);
+        miner::bench_solver(cfg);
+#if ENABLE_GLPK_SOLVER
+        miner::bench_endgame(cfg);
+        miner::bench_parallel(cfg);
+#endif
+    }
+
+    return 0;
+}
@@ -0,0 +1,194 @@
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "bit_kernels.h"
+
+namespace miner {
+namespace kernels {
+
+void or3(const uint64_t* a, const uint64_t* b, const uint64_t* c, uint64_t* out, size_t n) {
+    size_t i{};
+#if defined(__AVX2__)
+    for(; i + 4 <= n; i += 4) {
+        auto v = _mm256_or_si256(
+          _mm256_loadu_si256((const __m256i*)(a + i)),
+          _mm256_loadu_si256((const __m256i*)(b + i)));
+        v = _mm256_or_si256(v, _mm256_loadu_si256((const __m256i*)(c + i)));
+        _mm256_storeu_si256((__m256i*)(out + i), v);
+    }
+#elif defined(__SSE2__)
+    for(; i + 2 <= n; i += 2) {
+        auto v = _mm_or_si128(
+          _mm_loadu_si128((const __m128i*)(a + i)),
+          _mm_loadu_si128((const __m128i*)(b + i)));
+        v = _mm_or_si128(v, _mm_loadu_si128((const __m128i*)(c + i)));
+        _mm_storeu_si128((__m128i*)(out + i), v);
+    }
+#endif
+    for(; i < n; ++i)
+        out[i] = a[i] | b[i] | c[i];
+}
+
+
+void nor3(const uint64_t* a, const uint64_t* b, const uint64_t* c, uint64_t* out, size_t n) {
+    size_t i{};
+#if defined(__AVX2__)
+    auto ones = _mm256_set1_epi32(-1);
+    for(; i + 4 <= n; i += 4) {
+        auto v = _mm256_or_si256(
+          _mm256_loadu_si256((const __m256i*)(a + i)),
+          _mm256_loadu_si256((const __m256i*)(b + i)));
+        v = _mm256_or_si256(v, _mm256_loadu_si256((const __m256i*)(c + i)));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_xor_si256(v, ones));
+    }
+#elif defined(__SSE2__)
+    auto ones = _mm_set1_epi32(-1);
+    for(; i + 2 <= n; i += 2) {
+        auto v = _mm_or_si128(
+          _mm_loadu_si128((const __m128i*)(a + i)),
+          _mm_loadu_si128((const __m128i*)(b + i)));
+        v = _mm_or_si128(v, _mm_loadu_si128((const __m128i*)(c + i)));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_xor_si128(v, ones));
+    }
+#endif
+    for(; i < n; ++i)
+        out[i] = ~(a[i] | b[i] | c[i]);
+}
+
+
+size_t popcount(const uint64_t* p, size_t n) {
+    size_t rv{}, i{};
+#if defined(__AVX2__)
+    // nibble lookup popcount (W. Mula), accumulated with sad_epu8
+    const auto lut = _mm256_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const auto low = _mm256_set1_epi8(0x0f);
+    auto acc = _mm256_setzero_si256();
+    for(; i + 4 <= n; i += 4) {
+        auto v = _mm256_loadu_si256((const __m256i*)(p + i));
+        auto cnt = _mm256_add_epi8(
+          _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low)),
+          _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+    }
+    rv = _mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1)
+        + _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3);
+#endif
+    for(; i < n; ++i)
+        rv += __builtin_popcountll(p[i]);
+    return rv;
+}
+
+
+namespace {
+
+#if defined(__SSE2__)
+// expands 16 bits into 16 bytes, 0xff for set bits
+inline __m128i expand_bits16(unsigned bits) {
+    const auto sel = _mm_setr_epi8(
+      1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    auto v = _mm_cvtsi32_si128(bits);
+    v = _mm_unpacklo_epi8(v, v);
+    v = _mm_unpacklo_epi16(v, v);
+    v = _mm_unpacklo_epi32(v, v);
+    return _mm_cmpeq_epi8(_mm_and_si128(v, sel), sel);
+}
+
+inline __m128i select(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#endif
+
+} // namespace
+
+
+void unpack_bits(const uint64_t* words, size_t n, uint8_t* out) {
+    size_t i{};
+#if defined(__SSE2__)
+    const auto one = _mm_set1_epi8(1);
+    for(; i + 16 <= n; i += 16) {
+        auto bits = (words[i / 64] >> (i % 64)) & 0xffff;
+        _mm_storeu_si128((__m128i*)(out + i), _mm_and_si128(expand_bits16(bits), one));
+    }
+#endif
+    for(; i < n; ++i)
+        out[i] = (words[i / 64] >> (i % 64)) & 1;
+}
+
+
+void box_sum3(const uint8_t* a, const uint8_t* b, const uint8_t* c, uint8_t* out, size_t n) {
+    size_t i{};
+#if defined(__AVX2__)
+    for(; i + 32 <= n; i += 32) {
+        auto load3 = [i](const uint8_t* p) {
+            return _mm256_add_epi8(
+              _mm256_add_epi8(_mm256_loadu_si256((const __m256i*)(p + i - 1)),
+                              _mm256_loadu_si256((const __m256i*)(p + i))),
+              _mm256_loadu_si256((const __m256i*)(p + i + 1)));
+        };
+        auto v = _mm256_add_epi8(_mm256_add_epi8(load3(a), load3(b)), load3(c));
+        v = _mm256_sub_epi8(v, _mm256_loadu_si256((const __m256i*)(b + i)));
+        _mm256_storeu_si256((__m256i*)(out + i), v);
+    }
+#elif defined(__SSE2__)
+    for(; i + 16 <= n; i += 16) {
+        auto load3 = [i](const uint8_t* p) {
+            return _mm_add_epi8(
+              _mm_add_epi8(_mm_loadu_si128((const __m128i*)(p + i - 1)),
+                           _mm_loadu_si128((const __m128i*)(p + i))),
+              _mm_loadu_si128((const __m128i*)(p + i + 1)));
+        };
+        auto v = _mm_add_epi8(_mm_add_epi8(load3(a), load3(b)), load3(c));
+        v = _mm_sub_epi8(v, _mm_loadu_si128((const __m128i*)(b + i)));
+        _mm_storeu_si128((__m128i*)(out + i), v);
+    }
+#endif
+    for(; i < n; ++i)
+        out[i] = a[i - 1] + a[i] + a[i + 1] + b[i - 1] + b[i + 1] + c[i - 1] + c[i] + c[i + 1];
+}
+
+
+void decode_cells(
+  const uint64_t* uncovered, const uint64_t* marked, const uint64_t* exploded,
+  const uint64_t* counts, size_t n, int8_t* out) {
+
+    // keep in sync with GameBoard::CellInfo
+    constexpr int8_t kExploded = -3, kMarked = -2, kUnknown = -1;
+
+    for(size_t w = 0; w < n; ++w) {
+        uint64_t u = uncovered[w], m = marked[w], x = exploded[w];
+
+#if defined(__SSE2__)
+        const auto low = _mm_set1_epi8(0x0f);
+        for(unsigned k = 0; k < 4; ++k, out += 16) {
+            // 16 nibbles -> 16 bytes, low nibble first
+            auto nib = _mm_cvtsi64_si128(counts[w * 4 + k]);
+            auto lo = _mm_and_si128(nib, low);
+            auto hi = _mm_and_si128(_mm_srli_epi16(nib, 4), low);
+            auto values = _mm_unpacklo_epi8(lo, hi);
+
+            auto r = _mm_set1_epi8(kUnknown);
+            r = select(expand_bits16((m >> (16 * k)) & 0xffff), _mm_set1_epi8(kMarked), r);
+            r = select(expand_bits16((x >> (16 * k)) & 0xffff), _mm_set1_epi8(kExploded), r);
+            r = select(expand_bits16((u >> (16 * k)) & 0xffff), values, r);
+            _mm_storeu_si128((__m128i*)out, r);
+        }
+#else
+        for(unsigned b = 0; b < 64; ++b, ++out) {
+            if ((u >> b) & 1)
+                *out = (counts[w * 4 + b / 16] >> (b % 16 * 4)) & 0x0f;
+            else if ((m >> b) & 1)
+                *out = kMarked;
+            else if ((x >> b) & 1)
+                *out = kExploded;
+            else
+                *out = kUnknown;
+        }
+#endif
+    }
+}
+
+} // namespace kernels
+} // namespace miner
@@ -0,0 +1,34 @@
+#pragma once
+
+//
+// Word-wise kernels over bit-plane rows (see packed_plane.h). Built with
+// SSE2 or AVX2 when the compiler targets them, scalar code otherwise.
+//
+
+namespace miner {
+namespace kernels {
+
+// out[i] = a[i] | b[i] | c[i]
+void or3(const uint64_t* a, const uint64_t* b, const uint64_t* c, uint64_t* out, size_t n);
+
+// out[i] = ~(a[i] | b[i] | c[i])
+void nor3(const uint64_t* a, const uint64_t* b, const uint64_t* c, uint64_t* out, size_t n);
+
+// number of set bits in n words
+size_t popcount(const uint64_t*, size_t n);
+
+// Expands n bits (least significant first) into n bytes of 0 or 1.
+void unpack_bits(const uint64_t* words, size_t n, uint8_t* out);
+
+// 3x3 box sum minus the center: out[i] = sum of a, b and c over [i-1, i+1]
+// less b[i]. Inputs must be readable (and zero) at index -1 and n.
+void box_sum3(const uint8_t* a, const uint8_t* b, const uint8_t* c, uint8_t* out, size_t n);
+
+// Converts n words of board bit-planes into one GameBoard::CellInfo value per
+// cell (64 * n values). "counts" is a 4-bit plane, i.e. holds 4 * n words.
+void decode_cells(
+  const uint64_t* uncovered, const uint64_t* marked, const uint64_t* exploded,
+  const uint64_t* counts, size_t n, int8_t* out);
+
+} // namespace kernels
+} // namespace miner
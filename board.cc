@@ -1,17 +1,42 @@
+#include "bit_kernels.h"
 #include "board.h"
 
 namespace miner {
 
 void GameBoard::uncovered_safe(Location l, uint8_t v) {
-    edit_at(l) = static_cast<CellInfo>(v);
+    counts_.set(l.row, l.col, v);
+    uncovered_.set(l.row, l.col, 1);
     ++uncovered_nr_;
 }
 
 
+GameBoard::GameBoard(const GameBoard& other) {
+    *this = other;
+}
+
+
+GameBoard& GameBoard::operator=(const GameBoard& other) {
+    field_ = other.field_;
+    uncovered_ = other.uncovered_;
+    marked_ = other.marked_;
+    exploded_ = other.exploded_;
+    counts_ = other.counts_;
+    mines_marked_ = other.mines_marked_.load();
+    uncovered_nr_ = other.uncovered_nr_.load();
+    game_lost_ = other.game_lost_.load();
+    return *this;
+}
+
+
 void GameBoard::set_field(FieldPtr field) {
     field_ = field;
-    data_.resize(field_->rows() * field_->cols());
-    std::fill(data_.begin(), data_.end(), CellInfo::Unknown);
+    auto storage = field_->tiled() ? PlaneStorage::kTiled : PlaneStorage::kDense;
+    uncovered_.reset(field_->rows(), field_->cols(), storage);
+    marked_.reset(field_->rows(), field_->cols(), storage);
+    exploded_.reset(field_->rows(), field_->cols(), storage);
+    counts_.reset(field_->rows(), field_->cols(), storage);
+    mines_marked_ = 0;
+    uncovered_nr_ = 0;
 }
 
 
@@ -43,25 +68,263 @@ CellNeighborhoodIterator::CellNeighborhoodIterator(GameBoard* board, Location l)
 
 
 void GameBoard::mark_mine(Location l, bool v) {
-    auto& ci = edit_at(l);
+    auto ci = at(l);
     
     if (v) {
 	if (ci != CellInfo::Unknown)
 	    return;
 	
-	ci = CellInfo::MarkedMine;
+	marked_.set(l.row, l.col, 1);
 	++mines_marked_;
 	
     } else {
 	if (ci != CellInfo::MarkedMine)
 	    return;
         
-	ci = CellInfo::Unknown;
+	marked_.set(l.row, l.col, 0);
 	--mines_marked_;
     }
 }
 
 
+// Scanline flood fill: each popped seed opens the run of unknown N0 cells
+// through it, then the unknown cells around the run, queueing one seed per
+// run of unknown N0 cells in the rows above and below.
+GameBoard::Area GameBoard::open_zeros(Location l, std::vector<Location>& border, const Area& area) {
+    Area rv{l.row, l.col, l.row + 1, l.col + 1};
+    size_t opened{};
+    
+    auto unknown = [this](size_t row, size_t col) {
+	return !uncovered_.get(row, col) and !marked_.get(row, col) and !exploded_.get(row, col);
+    };
+    auto zero = [this](size_t row, size_t col) {
+	return !field_->is_mined({row, col}) and !field_->nearby_mines_nr({row, col});
+    };
+    auto open = [&](size_t row, size_t col, uint8_t v) {
+	counts_.set(row, col, v);
+	uncovered_.set(row, col, 1);
+	++opened;
+	rv.row0 = std::min(rv.row0, row);
+	rv.row1 = std::max(rv.row1, row + 1);
+	rv.col0 = std::min(rv.col0, col);
+	rv.col1 = std::max(rv.col1, col + 1);
+    };
+    
+    // neighbors outside of area which aren't cut off by the board's edge
+    bool cut_above = area.row0 > 0, cut_below = area.row1 < rows();
+    bool cut_left = area.col0 > 0, cut_right = area.col1 < cols();
+    
+    auto border0 = border.size();
+    std::vector<Location> seeds{l};
+    while(!seeds.empty()) {
+	auto s = seeds.back();
+	seeds.pop_back();
+	if (!(s == l) and !unknown(s.row, s.col))
+	    continue; // opened by another run since
+	
+	size_t c0 = s.col, c1 = s.col + 1;
+	while(c0 > area.col0 and unknown(s.row, c0 - 1) and zero(s.row, c0 - 1))
+	    --c0;
+	while(c1 < area.col1 and unknown(s.row, c1) and zero(s.row, c1))
+	    ++c1;
+	for(auto col = c0; col < c1; ++col)
+	    if (unknown(s.row, col))
+		open(s.row, col, 0);
+	
+	if ((s.row == area.row0 and cut_above) or (s.row + 1 == area.row1 and cut_below)) {
+	    for(auto col = c0; col < c1; ++col)
+		border.push_back({s.row, col});
+	} else {
+	    if (c0 == area.col0 and cut_left)
+		border.push_back({s.row, c0});
+	    if (c1 == area.col1 and cut_right)
+		border.push_back({s.row, c1 - 1});
+	}
+	
+	auto n0 = std::max(area.col0, i::subtract_floor_0(c0, 1));
+	auto n1 = std::min(area.col1, c1 + 1);
+	auto r0 = std::max(area.row0, i::subtract_floor_0(s.row, 1));
+	auto r1 = std::min(area.row1, size_t(s.row) + 2);
+	for(auto row = r0; row < r1; ++row) {
+	    bool run{}; // of unknown N0 cells, with a seed already
+	    for(auto col = n0; col < n1; ++col) {
+		if (!unknown(row, col)) {
+		    // numbered cells around the region lost unknown neighbors
+		    if (uncovered_.get(row, col) and counts_.get(row, col))
+			border.push_back({row, col});
+		    run = false;
+		    continue;
+		}
+		
+		// not mined, next to a N0 cell
+		auto v = field_->nearby_mines_nr({row, col});
+		if (!v) {
+		    if (!run and row != s.row)
+			seeds.push_back({row, col});
+		    run = true;
+		    continue;
+		}
+		
+		run = false;
+		open(row, col, v);
+		border.push_back({row, col});
+	    }
+	}
+    }
+    
+    // cells next to several runs were seen by each of them
+    std::sort(border.begin() + border0, border.end(), [](const Location& a, const Location& b) {
+	return a.row < b.row or (a.row == b.row and a.col < b.col);
+    });
+    border.erase(std::unique(border.begin() + border0, border.end()), border.end());
+    
+    uncovered_nr_ += opened;
+    return rv;
+}
+
+
+void GameBoard::frontier(std::vector<Location>& out) const {
+    auto n = uncovered_.words_per_row();
+    if (!n)
+	return;
+    if (tiled())
+	return tiled_frontier(out);
+    
+    // rolling window of "unknown" rows above/at/below the current one
+    std::vector<uint64_t> prev(n), cur(n), next(n), around(n);
+    auto unknown_row = [&](size_t row, std::vector<uint64_t>& dst) {
+	kernels::nor3(uncovered_.row_data(row), marked_.row_data(row),
+                      exploded_.row_data(row), dst.data(), n);
+	dst[n - 1] &= uncovered_.last_word_mask();
+    };
+    
+    if (rows())
+	unknown_row(0, cur);
+    
+    for(size_t row = 0; row < rows(); ++row) {
+	if (row + 1 < rows())
+	    unknown_row(row + 1, next);
+	else
+	    std::fill(next.begin(), next.end(), 0);
+	
+	kernels::or3(prev.data(), cur.data(), next.data(), around.data(), n);
+	
+	auto uncovered = uncovered_.row_data(row);
+	for(size_t w = 0; w < n; ++w) {
+	    // spread unknown cells one column left and right
+	    uint64_t a = around[w];
+	    uint64_t h = a | (a << 1) | (a >> 1);
+	    if (w > 0)
+		h |= around[w - 1] >> 63;
+	    if (w + 1 < n)
+		h |= around[w + 1] << 63;
+	    
+	    for(uint64_t bits = uncovered[w] & h; bits; bits &= bits - 1)
+		out.push_back({row, w * 64 + __builtin_ctzll(bits)});
+	}
+	
+	prev.swap(cur);
+	cur.swap(next);
+    }
+}
+
+
+void GameBoard::unknown(std::vector<Location>& out) const {
+    auto n = uncovered_.words_per_row();
+    std::vector<uint64_t> bits(n);
+    for(size_t row = 0; row < rows(); ++row) {
+	if (tiled()) {
+	    for(size_t w = 0; w < n; ++w)
+		bits[w] = ~(uncovered_.word(row, w) | marked_.word(row, w) | exploded_.word(row, w));
+	} else {
+	    kernels::nor3(uncovered_.row_data(row), marked_.row_data(row),
+                          exploded_.row_data(row), bits.data(), n);
+	}
+	if (n)
+	    bits[n - 1] &= uncovered_.last_word_mask();
+	
+	for(size_t w = 0; w < n; ++w)
+	    for(auto b = bits[w]; b; b &= b - 1)
+		out.push_back({row, w * 64 + __builtin_ctzll(b)});
+    }
+}
+
+
+// Frontier of a sparse board: looks only around uncovered words of allocated
+// tiles, reading the words next to them one by one.
+void GameBoard::tiled_frontier(std::vector<Location>& out) const {
+    auto n = uncovered_.words_per_row();
+    auto unknown = [&](size_t row, size_t w) -> uint64_t {
+	if (row >= rows() or w >= n)
+	    return 0;
+	auto v = ~(uncovered_.word(row, w) | marked_.word(row, w) | exploded_.word(row, w));
+	return w + 1 == n ? v & uncovered_.last_word_mask() : v;
+    };
+    
+    uncovered_.for_each_block([&](size_t row0, size_t rows, size_t w0, size_t words) {
+	for(auto row = row0; row < row0 + rows; ++row)
+	    for(auto w = w0; w < w0 + words; ++w) {
+		auto uncovered = uncovered_.word(row, w);
+		if (!uncovered)
+		    continue;
+		
+		uint64_t around[3]{}; // words w - 1, w, w + 1 of rows row - 1 .. row + 1
+		for(auto r = row > 0 ? row - 1 : row; r <= row + 1; ++r)
+		    for(size_t k = 0; k < 3; ++k)
+			if (w + k > 0)
+			    around[k] |= unknown(r, w + k - 1);
+		
+		uint64_t a = around[1];
+		uint64_t h = a | (a << 1) | (a >> 1) | (around[0] >> 63) | (around[2] << 63);
+		for(uint64_t bits = uncovered & h; bits; bits &= bits - 1)
+		    out.push_back({row, w * 64 + __builtin_ctzll(bits)});
+	    }
+    });
+}
+
+
+void GameBoard::decode_row(size_t row, size_t col0, size_t nr, CellInfo* out) const {
+    constexpr size_t kChunkWords = 4;
+    int8_t buf[kChunkWords * 64];
+    
+    auto w = col0 / 64;
+    auto skip = col0 % 64;
+    while(nr) {
+	// as many words as are contiguous in all planes
+	size_t nu, nm, ne, nc;
+	auto uncovered = uncovered_.words(row, w, nu);
+	auto marked = marked_.words(row, w, nm);
+	auto exploded = exploded_.words(row, w, ne);
+	auto counts = counts_.words(row, w * 4, nc);
+	auto words = std::min({kChunkWords, (skip + nr + 63) / 64, nu, nm, ne, nc / 4});
+	kernels::decode_cells(uncovered, marked, exploded, counts, words, buf);
+	
+	auto k = std::min(nr, words * 64 - skip);
+	memcpy(out, buf + skip, k);
+	out += k;
+	nr -= k;
+	w += words;
+	skip = 0;
+    }
+}
+
+
+void GameBoard::recount() {
+    auto count = [](const BitPlane& plane) {
+	size_t rv = 0;
+	plane.for_each_block([&](size_t row0, size_t rows, size_t w0, size_t words) {
+	    for(auto row = row0; row < row0 + rows; ++row) {
+		size_t nr;
+		rv += kernels::popcount(plane.words(row, w0, nr), words);
+	    }
+	});
+	return rv;
+    };
+    uncovered_nr_ = count(uncovered_);
+    mines_marked_ = count(marked_);
+}
+
+
 void GameBoard::dump_region(Location poi, size_t range) const {
     std::cout << "center=" << poi << "\n";
     size_t col0 = poi.col > range + 1 ? poi.col - range - 1 : 0;
@@ -72,10 +335,12 @@ void GameBoard::dump_region(Location poi, size_t range) const {
         ++row) {
         
 	std::cout << row << ": ";
+	std::vector<CellInfo> cells(col1 - col0 + 1);
+	decode_row(row, col0, cells.size(), cells.data());
 	for(size_t col = col0; col <= col1; ++col) {
 	    Location l{row, col};
 	    char ch{};
-	    auto v = at(l);
+	    auto v = cells[col - col0];
 	    switch(v) {
 	    case CellInfo::Exploded:
 		ch = '!';
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "field.h"
+#include "packed_plane.h"
 
 namespace miner {
 
@@ -23,32 +24,67 @@ public:
 	N8 = 8,
     };
     
+    // rows [row0, row1) and columns [col0, col1)
+    struct Area {
+	size_t row0, col0;
+	size_t row1, col1;
+    };
+    
+    GameBoard() = default;
+    GameBoard(const GameBoard&);
+    GameBoard& operator=(const GameBoard&);
+    
     void set_field(FieldPtr);
-    CellInfo at(Location l) const { return data_[to_index(l)]; }
+    CellInfo at(Location l) const;
     void mark_mine(Location, bool);
-    void mark_exploded(Location l) { edit_at(l) = CellInfo::Exploded; }
+    void mark_exploded(Location l) { exploded_.set(l.row, l.col, 1); }
     void uncovered_safe(Location, uint8_t);
     size_t rows() const { return field_->rows(); }
     size_t cols() const { return field_->cols(); }
+    CellIndex index(Location l) const { return field_->index(l); }
+    Location location(CellIndex i) const { return field_->location(i); }
     size_t mines_marked() const { return mines_marked_; }
-    FieldCPtr field() const { return field_; }
+    bool tiled() const { return uncovered_.tiled(); } // see Field::tiled()
+    const Field* field() const { return field_.get(); } // no refcounting in hot paths
     CellNeighborhoodIterator neighborhood(Location);
     bool is_uncovered(Location l) const { return static_cast<int>(at(l)) >= 0; }
     bool game_lost() const { return game_lost_; }
     void set_game_lost() { game_lost_ = true; }
     size_t uncovered_nr() const { return uncovered_nr_; }
-    size_t left_nr() const { return data_.size() - uncovered_nr_ - mines_marked_; }
+    size_t left_nr() const { return rows() * cols() - uncovered_nr_ - mines_marked_; }
     void dump_region(Location, size_t range) const;
     
+    // Whole-board operations over bit-planes
+    void frontier(std::vector<Location>&) const; // appends uncovered cells with unknown neighbors
+    void unknown(std::vector<Location>&) const;  // appends unknown cells, a word at a time
+    void decode_row(size_t row, size_t col0, size_t nr, CellInfo* out) const;
+    void recount(); // recalculates mines_marked() and uncovered_nr() from bit-planes
+    
+    // Opens the region of N0 cells connected to l, an uncovered N0 cell, and
+    // the numbered cells around it, without leaving "area". Appends the
+    // numbered cells around the region to "border", the ones it opened and
+    // those which were open already, and N0 cells at the edge of "area",
+    // whose neighbors outside of it are left as they are. Returns the
+    // smallest area holding l and the opened cells.
+    Area open_zeros(Location l, std::vector<Location>& border, const Area& area);
+    Area open_zeros(Location l, std::vector<Location>& border) {
+	return open_zeros(l, border, {0, 0, rows(), cols()});
+    }
+    
 private:
-    size_t to_index(const Location& l) const { return field_->cols() * l.row + l.col; }
-    CellInfo& edit_at(Location l) { return data_[to_index(l)]; }
+    friend class BoardFile;
+    
+    void tiled_frontier(std::vector<Location>&) const;
     
     FieldPtr field_;
-    std::vector<CellInfo> data_;
-    size_t mines_marked_{};
-    size_t uncovered_nr_{};
-    bool game_lost_{};
+    BitPlane uncovered_;
+    BitPlane marked_;
+    BitPlane exploded_;
+    NibblePlane counts_; // mines around uncovered cells
+    // updated concurrently by ParallelSolver's workers
+    std::atomic<size_t> mines_marked_{};
+    std::atomic<size_t> uncovered_nr_{};
+    std::atomic<bool> game_lost_{};
 };
 
 using GameBoardPtr = std::shared_ptr<GameBoard>;
@@ -68,6 +104,15 @@ private:
     GameBoard* board_{};
 };
 
+inline GameBoard::CellInfo GameBoard::at(Location l) const {
+    if (uncovered_.get(l.row, l.col))
+        return static_cast<CellInfo>(counts_.get(l.row, l.col));
+    if (marked_.get(l.row, l.col))
+        return CellInfo::MarkedMine;
+    return exploded_.get(l.row, l.col) ? CellInfo::Exploded : CellInfo::Unknown;
+}
+
+
 inline CellNeighborhoodIterator
 GameBoard::neighborhood(Location l) {
     return CellNeighborhoodIterator(this, l);
@@ -0,0 +1,313 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "board_file.h"
+
+namespace miner {
+
+namespace {
+
+const char kMagic[8] = {'M', 'I', 'N', 'E', 'R', 'B', 'R', 'D'};
+
+void write_all(int fd, const void* data, size_t size, uint64_t offset) {
+    auto p = static_cast<const char*>(data);
+    while(size) {
+        auto n = pwrite(fd, p, size, offset);
+        if (n < 0 and errno == EINTR)
+            continue;
+        I_ASSERT(n > 0, EX_LOG("write failed: " << strerror(errno)));
+        p += n;
+        size -= n;
+        offset += n;
+    }
+}
+
+
+void read_all(int fd, void* data, size_t size, uint64_t offset) {
+    auto p = static_cast<char*>(data);
+    while(size) {
+        auto n = pread(fd, p, size, offset);
+        if (n < 0 and errno == EINTR)
+            continue;
+        I_ASSERT(n >= 0, EX_LOG("read failed: " << strerror(errno)));
+        I_ASSERT(n > 0, EX_LOG("unexpected end of file"));
+        p += n;
+        size -= n;
+        offset += n;
+    }
+}
+
+} // namespace
+
+
+struct BoardFile::Mapping {
+    Mapping(void* a, size_t s) : addr{a}, size{s} {}
+    ~Mapping() { munmap(addr, size); }
+
+    void* addr;
+    size_t size;
+};
+
+
+BoardFile::~BoardFile() {
+    try {
+        close();
+    } catch(const std::exception& e) {
+        errlog << "can't close " << path_ << ": " << e.what();
+    }
+}
+
+
+void BoardFile::layout(Header& h, size_t rows, size_t cols, uint64_t& file_size) {
+    static_assert(sizeof(Header) <= kPageSize, "header must fit its page");
+    static const unsigned kBits[kPlanesNr] = {1, 8, 1, 1, 1, 4};
+
+    uint64_t offset = kPageSize;
+    for(size_t p = 0; p < kPlanesNr; ++p) {
+        h.planes[p] = offset;
+        uint64_t size = uint64_t(rows) * ((cols + 63) / 64 * kBits[p]) * 8;
+        offset += (size + kPageSize - 1) / kPageSize * kPageSize;
+    }
+    file_size = offset;
+}
+
+
+// Writes the words of a plane at "offset"; missing tiles are left as holes,
+// and with "dirty_only" so are the tiles not written since clear_dirty().
+template<unsigned kBits>
+void BoardFile::write_plane(int fd, uint64_t offset, const PackedPlane<kBits>& plane, bool dirty_only) {
+    auto stride = plane.words_per_row();
+    if (!plane.tiled()) {
+        write_all(fd, plane.row_data(0), plane.rows() * stride * 8, offset);
+        return;
+    }
+
+    plane.for_each_block([&](size_t row0, size_t rows, size_t w0, size_t words) {
+        for(auto row = row0; row < row0 + rows; ++row) {
+            size_t nr;
+            write_all(fd, plane.words(row, w0, nr), words * 8, offset + (row * stride + w0) * 8);
+        }
+    }, dirty_only);
+}
+
+
+void BoardFile::save(const GameBoard& board, const std::string& path) {
+    auto& field = *board.field_;
+    Header h{};
+    memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.flags = board.game_lost() ? kGameLost : 0;
+    h.rows = field.rows();
+    h.cols = field.cols();
+    h.mines_nr = field.mines_nr();
+    h.uncovered_nr = board.uncovered_nr();
+    h.mines_marked = board.mines_marked();
+    h.seed = field.seed();
+    h.generated_mines_nr = field.lazy() ? field.generator_->mines_nr() : 0;
+    uint64_t size;
+    layout(h, h.rows, h.cols, size);
+
+    // a new file, so that a board mapped from "path" isn't changed under it
+    auto tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    I_ASSERT(fd >= 0, EX_LOG("can't create " << tmp << ": " << strerror(errno)));
+    try {
+        I_ASSERT(!ftruncate(fd, size), EX_LOG("can't resize " << tmp << ": " << strerror(errno)));
+        write_all(fd, &h, sizeof(h), 0);
+        write_plane(fd, h.planes[kMined], field.mined_);
+        write_plane(fd, h.planes[kNearby], field.counts_);
+        write_plane(fd, h.planes[kUncovered], board.uncovered_);
+        write_plane(fd, h.planes[kMarked], board.marked_);
+        write_plane(fd, h.planes[kExploded], board.exploded_);
+        write_plane(fd, h.planes[kCounts], board.counts_);
+        I_ASSERT(!fdatasync(fd), EX_LOG("can't write " << tmp << ": " << strerror(errno)));
+    } catch(...) {
+        ::close(fd);
+        unlink(tmp.c_str());
+        throw;
+    }
+
+    ::close(fd);
+    I_ASSERT(!rename(tmp.c_str(), path.c_str()),
+             EX_LOG("can't rename " << tmp << " to " << path << ": " << strerror(errno)));
+}
+
+
+// Maps a plane from the file, or reads the nonzero words of its data extents
+// into tiled storage.
+template<unsigned kBits>
+void BoardFile::load_plane(PackedPlane<kBits>& plane, Plane p) {
+    auto offset = header_.planes[p];
+    if (!tiled_) {
+        auto words = reinterpret_cast<uint64_t*>(static_cast<char*>(mapping_->addr) + offset);
+        plane.map(header_.rows, header_.cols, words, mapping_);
+        return;
+    }
+
+    plane.reset(header_.rows, header_.cols, PlaneStorage::kTiled);
+    auto stride = plane.words_per_row();
+    auto end = offset + header_.rows * stride * 8;
+    std::vector<uint64_t> buf(uint64_t{1} << 16);
+    for(auto pos = offset; pos < end; ) {
+        off_t data = lseek(fd_, pos, SEEK_DATA);
+        if (data < 0 and errno == ENXIO)
+            break; // only holes left
+        if (data < 0)
+            data = pos; // no hole support, read everything
+        if (uint64_t(data) >= end)
+            break;
+        off_t hole = lseek(fd_, data, SEEK_HOLE);
+        auto extent_end = hole < 0 ? end : std::min(uint64_t(hole), end);
+
+        for(uint64_t at = data; at < extent_end; ) {
+            auto n = std::min(buf.size() * 8, extent_end - at);
+            read_all(fd_, buf.data(), n, at);
+            auto k = (at - offset) / 8;
+            for(size_t i = 0; i < n / 8; ++i, ++k)
+                if (buf[i])
+                    plane.set_word(k / stride, k % stride, buf[i]);
+            at += n;
+        }
+        pos = extent_end;
+    }
+    plane.clear_dirty(); // as in the file
+}
+
+
+GameBoardPtr BoardFile::open(const std::string& path, Mode mode) {
+    close();
+    fd_ = ::open(path.c_str(), mode == Mode::kShared ? O_RDWR : O_RDONLY);
+    I_ASSERT(fd_ >= 0, EX_LOG("can't open " << path << ": " << strerror(errno)));
+    path_ = path;
+    mode_ = mode;
+
+    try {
+        read_all(fd_, &header_, sizeof(header_), 0);
+        I_ASSERT(!memcmp(header_.magic, kMagic, sizeof(kMagic)), EX_LOG(path << " is not a board file"));
+        I_ASSERT(header_.version <= kVersion,
+                 EX_LOG(path << " has format version " << header_.version << ", newer than " << kVersion));
+        I_ASSERT(header_.rows <= (uint64_t{1} << 32) and header_.cols <= (uint64_t{1} << 32),
+                 EX_LOG(path << " has a board of " << header_.rows << "x" << header_.cols));
+
+        Header expected = header_;
+        uint64_t size;
+        layout(expected, header_.rows, header_.cols, size);
+        struct stat st;
+        I_ASSERT(!fstat(fd_, &st) and uint64_t(st.st_size) >= size
+                 and std::equal(header_.planes, header_.planes + kPlanesNr, expected.planes),
+                 EX_LOG(path << " is truncated or corrupt"));
+
+        tiled_ = header_.rows * header_.cols > BitPlane::kMaxDenseCells;
+        if (!tiled_) {
+            auto addr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                             mode == Mode::kShared ? MAP_SHARED : MAP_PRIVATE, fd_, 0);
+            I_ASSERT(addr != MAP_FAILED, EX_LOG("can't map " << path << ": " << strerror(errno)));
+            mapping_ = std::make_shared<Mapping>(addr, size);
+        }
+
+        auto field = std::make_shared<Field>();
+        field->rows_ = header_.rows;
+        field->cols_ = header_.cols;
+        field->mines_nr_ = header_.mines_nr;
+        field->seed_ = header_.seed;
+        load_plane(field->mined_, kMined);
+        load_plane(field->counts_, kNearby);
+        if (header_.generated_mines_nr)
+            field->start_lazy(header_.generated_mines_nr);
+
+        auto board = std::make_shared<GameBoard>();
+        board->field_ = field;
+        load_plane(board->uncovered_, kUncovered);
+        load_plane(board->marked_, kMarked);
+        load_plane(board->exploded_, kExploded);
+        load_plane(board->counts_, kCounts);
+        board->game_lost_ = header_.flags & kGameLost;
+        if (header_.flags & kOpen) {
+            xlog << path << " wasn't closed, recounting its cells";
+            board->recount();
+        } else {
+            board->uncovered_nr_ = header_.uncovered_nr;
+            board->mines_marked_ = header_.mines_marked;
+        }
+
+        if (mode == Mode::kShared) {
+            header_.flags |= kOpen;
+            store_header();
+        }
+        board_ = board;
+
+    } catch(...) {
+        close();
+        throw;
+    }
+    return board_;
+}
+
+
+void BoardFile::store_header() {
+    if (tiled_)
+        write_all(fd_, &header_, sizeof(header_), 0);
+    else
+        memcpy(mapping_->addr, &header_, sizeof(header_));
+}
+
+
+void BoardFile::sync() {
+    if (!board_ or mode_ != Mode::kShared)
+        return;
+
+    auto& board = *board_;
+    auto& field = *board.field_;
+    header_.mines_nr = field.mines_nr();
+    header_.uncovered_nr = board.uncovered_nr();
+    header_.mines_marked = board.mines_marked();
+    header_.flags = (header_.flags & ~kGameLost) | (board.game_lost() ? kGameLost : 0);
+    store_header();
+
+    if (tiled_) {
+        // only the tiles the game (or a lazy field) wrote since the last sync
+        write_plane(fd_, header_.planes[kMined], field.mined_, true);
+        write_plane(fd_, header_.planes[kNearby], field.counts_, true);
+        write_plane(fd_, header_.planes[kUncovered], board.uncovered_, true);
+        write_plane(fd_, header_.planes[kMarked], board.marked_, true);
+        write_plane(fd_, header_.planes[kExploded], board.exploded_, true);
+        write_plane(fd_, header_.planes[kCounts], board.counts_, true);
+        I_ASSERT(!fdatasync(fd_), EX_LOG("can't write " << path_ << ": " << strerror(errno)));
+        field.mined_.clear_dirty();
+        field.counts_.clear_dirty();
+        board.uncovered_.clear_dirty();
+        board.marked_.clear_dirty();
+        board.exploded_.clear_dirty();
+        board.counts_.clear_dirty();
+    } else {
+        // only the pages the game dirtied are written
+        I_ASSERT(!msync(mapping_->addr, mapping_->size, MS_SYNC),
+                 EX_LOG("can't write " << path_ << ": " << strerror(errno)));
+    }
+}
+
+
+void BoardFile::close() {
+    std::exception_ptr error;
+    if (board_ and mode_ == Mode::kShared) {
+        header_.flags &= ~kOpen;
+        try {
+            sync();
+        } catch(...) {
+            error = std::current_exception();
+        }
+    }
+
+    // the planes keep the mapping while the board is in use
+    board_.reset();
+    mapping_.reset();
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+    if (error)
+        std::rethrow_exception(error);
+}
+
+} // namespace miner
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "board.h"
+
+namespace miner {
+
+//
+// Versioned binary file with a field and the state of a game on it. After a
+// header page come the planes of the field and of the board, each at a
+// page-aligned offset and laid out like a dense PackedPlane, in native
+// (little-endian) byte order.
+//
+// open() maps the file, so even multi-GB boards open at once and their pages
+// are read as the game touches them. In kShared mode the game's changes go
+// straight to the mapped file, and sync() only has to flush the pages they
+// dirtied. Huge boards, which are kept in tiled storage (see PackedPlane),
+// are read from the data extents of the file instead; save() leaves holes
+// where their tiles are missing, and sync() writes the tiles written since
+// the board was opened or last synced.
+//
+// Nothing may change the board while it is saved or synced: suspend its
+// solver first (see Solver::suspendAndWait()).
+//
+class BoardFile {
+public:
+    static constexpr uint32_t kVersion = 2; // 2: lazy fields
+
+    enum class Mode : uint8_t {
+        kPrivate, // changes stay in memory
+        kShared,  // changes are written back to the file
+    };
+
+    BoardFile() = default;
+    BoardFile(const BoardFile&) = delete;
+    BoardFile& operator=(const BoardFile&) = delete;
+    ~BoardFile();
+
+    // Writes a board and its field to a new file which then replaces "path".
+    static void save(const GameBoard&, const std::string& path);
+
+    // Opens a file written by save(). Throws i::exception on errors.
+    GameBoardPtr open(const std::string& path, Mode = Mode::kPrivate);
+
+    // Writes the changes of the opened board to the file (kShared mode only).
+    void sync();
+    void close();
+
+    const std::string& path() const { return path_; }
+    const GameBoardPtr& board() const { return board_; }
+
+private:
+    enum Plane : uint8_t {
+        kMined,     // Field::mined_
+        kNearby,    // Field::counts_
+        kUncovered, // GameBoard::uncovered_
+        kMarked,
+        kExploded,
+        kCounts,
+        kPlanesNr,
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        uint64_t rows, cols;
+        uint64_t mines_nr;
+        uint64_t uncovered_nr, mines_marked;
+        uint64_t planes[kPlanesNr]; // offsets
+        // since version 2; zeros in older files
+        int64_t seed;
+        uint64_t generated_mines_nr; // by the generator of a lazy field, else 0
+    };
+
+    static constexpr uint32_t kGameLost = 1;
+    static constexpr uint32_t kOpen = 2; // opened in kShared mode and not closed yet
+    static constexpr size_t kPageSize = 4096;
+
+    struct Mapping;
+
+    static void layout(Header&, size_t rows, size_t cols, uint64_t& file_size);
+    template<unsigned kBits>
+    static void write_plane(int fd, uint64_t offset, const PackedPlane<kBits>&, bool dirty_only = false);
+    template<unsigned kBits>
+    void load_plane(PackedPlane<kBits>&, Plane);
+    void store_header();
+
+    std::string path_;
+    Mode mode_{};
+    int fd_{-1};
+    bool tiled_{};
+    Header header_{};
+    std::shared_ptr<Mapping> mapping_; // unmapped when the last plane lets go
+    GameBoardPtr board_;
+};
+
+} // namespace miner
@@ -0,0 +1,258 @@
+#include "bounded_simplex.h"
+
+namespace miner {
+
+namespace {
+
+constexpr size_t kNone = size_t(-1);
+// consecutive pivots without progress after which Bland's rule prevents cycling
+constexpr size_t kBlandAfter = 32;
+
+} // namespace
+
+
+void BoundedSimplex::reset(size_t rows, size_t cols) {
+    rows_ = rows;
+    cols_ = cols;
+    width_ = cols + rows;
+    a_.assign(rows * cols, 0);
+    b_.assign(rows, 0);
+    lo_.assign(width_, 0);
+    hi_.assign(width_, 1);
+    feasible_ = false;
+}
+
+
+bool BoundedSimplex::feasible() {
+    t_.assign(rows_ * width_, 0);
+    beta_.assign(rows_, 0);
+    basic_.assign(rows_, kNone);
+    pos_.assign(width_, kNone);
+    state_.assign(width_, State::kLower);
+    cost_.assign(width_, 0);
+
+    // columns start at their lower bounds, artificials take up the residuals
+    for(size_t r = 0; r < rows_; ++r) {
+        auto a = a_.data() + r * cols_;
+        double residual = b_[r];
+        for(size_t c = 0; c < cols_; ++c)
+            residual -= a[c] * lo_[c];
+
+        double sign = residual < 0 ? -1 : 1;
+        auto t = row(r);
+        for(size_t c = 0; c < cols_; ++c)
+            t[c] = sign * a[c];
+
+        auto art = cols_ + r;
+        t[art] = 1;
+        beta_[r] = sign * residual;
+        basic_[r] = art;
+        pos_[art] = r;
+        state_[art] = State::kBasic;
+        lo_[art] = 0;
+        hi_[art] = HUGE_VAL;
+    }
+
+    // minimize the sum of artificials
+    for(size_t r = 0; r < rows_; ++r) {
+        auto t = row(r);
+        for(size_t c = 0; c < cols_; ++c)
+            cost_[c] -= t[c];
+    }
+
+    feasible_ = false;
+    if (!minimize(cost_.data()))
+        return false;
+
+    double infeasibility{};
+    for(size_t r = 0; r < rows_; ++r)
+        if (basic_[r] >= cols_)
+            infeasibility += beta_[r];
+    if (infeasibility > 1e-7)
+        return false;
+
+    // artificials left in the basis are stuck at 0 from now on
+    for(size_t art = cols_; art < width_; ++art) {
+        hi_[art] = 0;
+        if (pos_[art] != kNone)
+            beta_[pos_[art]] = 0;
+    }
+
+    feasible_ = true;
+    return true;
+}
+
+
+double BoundedSimplex::optimize(size_t col, bool maximize) {
+    I_ASSERT(feasible_, EX_LOG("no feasible basis"));
+
+    double c = maximize ? -1 : 1;
+    std::fill(cost_.begin(), cost_.end(), 0.);
+    if (state_[col] == State::kBasic) {
+        auto t = row(pos_[col]);
+        for(size_t j = 0; j < width_; ++j)
+            cost_[j] = -c * t[j];
+        cost_[col] = 0;
+    } else {
+        cost_[col] = c;
+    }
+
+    if (!minimize(cost_.data()))
+        errlog << "simplex: no optimum in " << iterations_ << " iterations";
+    return value(col);
+}
+
+
+bool BoundedSimplex::fix(size_t col, double v) {
+    bool ok = true;
+    if (state_[col] == State::kBasic) {
+        auto& x = beta_[pos_[col]];
+        ok = std::fabs(x - v) <= kTolerance;
+        x = v;
+    } else {
+        auto delta = v - value(col);
+        if (delta != 0)
+            for(size_t r = 0; r < rows_; ++r) {
+                beta_[r] -= delta * row(r)[col];
+                auto b = basic_[r];
+                ok = ok and beta_[r] >= lo_[b] - kTolerance and beta_[r] <= hi_[b] + kTolerance;
+            }
+        state_[col] = State::kLower;
+    }
+
+    lo_[col] = hi_[col] = v;
+    return ok or feasible();
+}
+
+
+double BoundedSimplex::value(size_t col) const {
+    switch(state_[col]) {
+    case State::kBasic:
+        return beta_[pos_[col]];
+    case State::kLower:
+        return lo_[col];
+    case State::kUpper:
+        return hi_[col];
+    }
+    return 0;
+}
+
+
+bool BoundedSimplex::minimize(double* cost) {
+    size_t degenerate{};
+    size_t limit = 50 * (rows_ + width_) + 1000;
+    for(size_t it = 0; it < limit; ++it) {
+        // entering column: largest rate of improvement, or the first
+        // improving one when progress stalls
+        size_t q = kNone;
+        double best{};
+        for(size_t j = 0; j < width_; ++j) {
+            if (state_[j] == State::kBasic or hi_[j] - lo_[j] <= kTolerance)
+                continue;
+
+            auto gain = state_[j] == State::kLower ? -cost[j] : cost[j];
+            if (gain <= kTolerance or gain <= best)
+                continue;
+
+            q = j;
+            best = gain;
+            if (degenerate > kBlandAfter)
+                break;
+        }
+
+        if (q == kNone)
+            return true;
+
+        // ratio test: basic variable of row i changes by -dir * t[i][q] per
+        // unit step of the entering one
+        double dir = state_[q] == State::kLower ? 1 : -1;
+        double step = hi_[q] - lo_[q];
+        size_t leave = kNone;
+        double pivot_abs{};
+        for(size_t r = 0; r < rows_; ++r) {
+            auto alpha = dir * row(r)[q];
+            auto b = basic_[r];
+            double room;
+            if (alpha > kTolerance)
+                room = (beta_[r] - lo_[b]) / alpha;
+            else if (alpha < -kTolerance and hi_[b] != HUGE_VAL)
+                room = (hi_[b] - beta_[r]) / -alpha;
+            else
+                continue;
+
+            room = std::max(room, 0.);
+            if (room < step - kTolerance
+                or (room <= step + kTolerance and leave != kNone and std::fabs(alpha) > pivot_abs)) {
+                step = room;
+                leave = r;
+                pivot_abs = std::fabs(alpha);
+            }
+        }
+
+        if (step == HUGE_VAL)
+            return false;
+
+        degenerate = step <= kTolerance ? degenerate + 1 : 0;
+        ++iterations_;
+        for(size_t r = 0; r < rows_; ++r)
+            beta_[r] -= dir * step * row(r)[q];
+
+        if (leave == kNone) {
+            state_[q] = state_[q] == State::kLower ? State::kUpper : State::kLower;
+            continue;
+        }
+
+        auto x = state_[q] == State::kLower ? lo_[q] + step : hi_[q] - step;
+        auto out = basic_[leave];
+        state_[out] = dir * row(leave)[q] > 0 ? State::kLower : State::kUpper;
+        pos_[out] = kNone;
+
+        pivot(leave, q, cost);
+
+        // artificials never come back, and zero columns stay zero in pivots
+        if (out >= cols_) {
+            state_[out] = State::kLower;
+            hi_[out] = 0;
+            for(size_t r = 0; r < rows_; ++r)
+                row(r)[out] = 0;
+            cost[out] = 0;
+        }
+        beta_[leave] = x;
+        basic_[leave] = q;
+        pos_[q] = leave;
+        state_[q] = State::kBasic;
+    }
+
+    return false;
+}
+
+
+void BoundedSimplex::pivot(size_t r, size_t q, double* cost) {
+    // rows of 0/1 constraints stay sparse for a while, so only nonzeros of
+    // the pivot row are eliminated
+    auto pr = row(r);
+    auto inv = 1 / pr[q];
+    nonzeros_.clear();
+    for(size_t j = 0; j < width_; ++j)
+        if (pr[j] != 0) {
+            pr[j] *= inv;
+            nonzeros_.push_back(j);
+        }
+    pr[q] = 1;
+
+    auto eliminate = [&](double* t) {
+        auto f = t[q];
+        if (f == 0)
+            return;
+        for(auto j: nonzeros_)
+            t[j] -= f * pr[j];
+        t[q] = 0;
+    };
+
+    for(size_t i = 0; i < rows_; ++i)
+        if (i != r)
+            eliminate(row(i));
+    eliminate(cost);
+}
+
+} // namespace miner
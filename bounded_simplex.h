@@ -0,0 +1,72 @@
+#pragma once
+
+namespace miner {
+
+//
+// Dense bounded-variable primal simplex for the small LPs of frontier
+// components: equality rows "A x = b" over columns with finite bounds. The
+// tableau is kept explicitly, which for a few dozen rows and columns is
+// cheaper than any factorization. A feasible basis is found once with
+// artificial columns (phase 1) and then reused by every optimize() call, so
+// probing a column usually takes a few pivots. Arrays are reused between
+// problems; nothing is allocated once they are large enough.
+//
+class BoundedSimplex {
+public:
+    static constexpr double kTolerance = 1e-9;
+
+    // Starts a problem with all-zero matrix and right hand side and columns
+    // bounded to [0, 1].
+    void reset(size_t rows, size_t cols);
+    void set(size_t row, size_t col, double v) { a_[row * cols_ + col] = v; }
+    void set_rhs(size_t row, double v) { b_[row] = v; }
+    void set_bounds(size_t col, double lo, double hi) { lo_[col] = lo; hi_[col] = hi; }
+
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+
+    // Finds a feasible point. Returns false if there is none.
+    bool feasible();
+
+    // Moves from the current feasible point to one where column's value is
+    // the largest (or smallest) possible, and returns the value. feasible()
+    // must have succeeded before.
+    double optimize(size_t col, bool maximize);
+
+    // Fixes column at a value it may have in some feasible point. Returns
+    // false if the problem turns out infeasible.
+    bool fix(size_t col, double v);
+
+    bool has_feasible_basis() const { return feasible_; }
+    double value(size_t col) const;
+    size_t iterations() const { return iterations_; } // pivots and bound flips so far
+
+private:
+    enum class State : uint8_t {
+        kBasic,
+        kLower,
+        kUpper,
+    };
+
+    // "cost" holds reduced costs of all tableau columns on entry
+    bool minimize(double* cost);
+    void pivot(size_t row, size_t col, double* cost);
+    double* row(size_t r) { return t_.data() + r * width_; }
+
+    size_t rows_{};
+    size_t cols_{};
+    size_t width_{}; // columns followed by one artificial per row
+    std::vector<double> a_, b_; // original problem, rows_ x cols_
+    std::vector<double> t_;     // tableau, rows_ x width_
+    std::vector<double> beta_;  // values of basic variables, by row
+    std::vector<double> lo_, hi_;
+    std::vector<double> cost_;
+    std::vector<size_t> basic_; // basic variable of each row
+    std::vector<size_t> pos_;   // row of each basic variable
+    std::vector<State> state_;
+    std::vector<uint32_t> nonzeros_; // of the pivot row
+    bool feasible_{};
+    size_t iterations_{};
+};
+
+} // namespace miner
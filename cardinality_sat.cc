@@ -0,0 +1,457 @@
+#include "cardinality_sat.h"
+
+namespace miner {
+
+namespace {
+
+constexpr double kActivityDecay = 0.95;
+constexpr size_t kRestartUnit = 64; // conflicts, scaled by the Luby sequence
+
+// 1, 1, 2, 1, 1, 2, 4, 1, 1, 2, 1, 1, 2, 4, 8, ...
+size_t luby(size_t i) {
+    size_t size = 1, seq = 0;
+    while(size < i + 1) {
+        ++seq;
+        size = 2 * size + 1;
+    }
+
+    while(size - 1 != i) {
+        size = (size - 1) >> 1;
+        --seq;
+        i %= size;
+    }
+
+    return size_t{1} << seq;
+}
+
+} // namespace
+
+
+constexpr uint32_t CardinalitySat::kNoReason;
+constexpr uint32_t CardinalitySat::kCardinality;
+constexpr CardinalitySat::Lit CardinalitySat::kNoLit;
+constexpr CardinalitySat::Var CardinalitySat::kNoVar;
+
+
+void CardinalitySat::reset(size_t vars_nr) {
+    vars_nr_ = vars_nr;
+    assigns_.assign(vars_nr, -1);
+    model_.assign(vars_nr, 0);
+    phase_.assign(vars_nr, 0); // cells are mostly safe
+    level_.assign(vars_nr, 0);
+    reason_.assign(vars_nr, kNoReason);
+    trail_pos_.assign(vars_nr, 0);
+    trail_.clear();
+    trail_lim_.clear();
+    qhead_ = 0;
+
+    cards_.clear();
+    card_vars_.clear();
+    occurs_.resize(vars_nr);
+    for(auto& o: occurs_)
+        o.clear();
+
+    clauses_.clear();
+    clause_lits_.clear();
+    watches_.resize(2 * vars_nr);
+    for(auto& w: watches_)
+        w.clear();
+
+    activity_.assign(vars_nr, 0);
+    bump_by_ = 1;
+    heap_.clear();
+    heap_pos_.assign(vars_nr, -1);
+    for(Var v = 0; v < vars_nr; ++v)
+        heap_insert(v);
+
+    seen_.assign(vars_nr, 0);
+    ok_ = true;
+}
+
+
+void CardinalitySat::add(const Var* vars, size_t nr, uint32_t lo, uint32_t hi) {
+    backtrack(0);
+    hi = std::min<uint32_t>(hi, nr);
+    if (lo > hi)
+        ok_ = false;
+    if (!ok_)
+        return;
+
+    Cardinality c{uint32_t(card_vars_.size()), uint32_t(nr), lo, hi};
+    auto id = uint32_t(cards_.size());
+    for(size_t i = 0; i < nr; ++i) {
+        card_vars_.push_back(vars[i]);
+        occurs_[vars[i]].push_back(id);
+        if (assigns_[vars[i]] >= 0)
+            ++(assigns_[vars[i]] ? c.trues : c.falses);
+    }
+    cards_.push_back(c);
+
+    if (propagate_cardinality(id) != kNoReason or propagate() != kNoReason)
+        ok_ = false;
+}
+
+
+void CardinalitySat::enqueue(Lit l, uint32_t reason) {
+    auto v = var(l);
+    auto value = int8_t(!(l & 1));
+    assigns_[v] = value;
+    level_[v] = level();
+    reason_[v] = reason;
+    trail_pos_[v] = trail_.size();
+    trail_.push_back(l);
+
+    for(auto c: occurs_[v])
+        ++(value ? cards_[c].trues : cards_[c].falses);
+}
+
+
+void CardinalitySat::backtrack(uint32_t lvl) {
+    if (level() <= lvl)
+        return;
+
+    for(auto i = trail_.size(); i-- > trail_lim_[lvl];) {
+        auto v = var(trail_[i]);
+        auto value = assigns_[v];
+        for(auto c: occurs_[v])
+            --(value ? cards_[c].trues : cards_[c].falses);
+
+        phase_[v] = value;
+        assigns_[v] = -1;
+        reason_[v] = kNoReason;
+        if (heap_pos_[v] < 0)
+            heap_insert(v);
+    }
+
+    trail_.resize(trail_lim_[lvl]);
+    trail_lim_.resize(lvl);
+    qhead_ = trail_.size();
+}
+
+
+uint32_t CardinalitySat::propagate() {
+    while(qhead_ < trail_.size()) {
+        auto p = trail_[qhead_++];
+        ++stats_.propagations;
+
+        for(auto c: occurs_[var(p)]) {
+            auto conflict = propagate_cardinality(c);
+            if (conflict != kNoReason)
+                return conflict;
+        }
+
+        auto conflict = propagate_clauses(p ^ 1);
+        if (conflict != kNoReason)
+            return conflict;
+    }
+
+    return kNoReason;
+}
+
+
+uint32_t CardinalitySat::propagate_cardinality(uint32_t id) {
+    auto& c = cards_[id];
+    if (c.trues > c.hi or c.size - c.falses < c.lo)
+        return kCardinality | id;
+
+    // at the upper bound, the rest are false; at the lower one, they are true
+    bool rest_false = c.trues == c.hi;
+    bool rest_true = c.size - c.falses == c.lo;
+    if ((!rest_false and !rest_true) or c.trues + c.falses == c.size)
+        return kNoReason;
+
+    for(uint32_t i = 0; i < c.size; ++i) {
+        auto v = card_vars_[c.begin + i];
+        if (assigns_[v] < 0)
+            enqueue(lit(v, !rest_false), kCardinality | id);
+    }
+
+    return kNoReason;
+}
+
+
+uint32_t CardinalitySat::propagate_clauses(Lit falsified) {
+    auto& ws = watches_[falsified];
+    size_t j = 0;
+    for(size_t i = 0; i < ws.size(); ++i) {
+        auto id = ws[i];
+        auto lits = clause_lits_.data() + clauses_[id].begin;
+        auto size = clauses_[id].size;
+        if (lits[0] == falsified)
+            std::swap(lits[0], lits[1]);
+
+        if (is_true(lits[0])) {
+            ws[j++] = id;
+            continue;
+        }
+
+        // look for another literal to watch
+        bool moved = false;
+        for(uint32_t k = 2; k < size and !moved; ++k)
+            if (!is_false(lits[k])) {
+                std::swap(lits[1], lits[k]);
+                watches_[lits[1]].push_back(id);
+                moved = true;
+            }
+        if (moved)
+            continue;
+
+        ws[j++] = id;
+        if (is_false(lits[0])) {
+            while(++i < ws.size())
+                ws[j++] = ws[i];
+            ws.resize(j);
+            return id;
+        }
+
+        enqueue(lits[0], id);
+    }
+
+    ws.resize(j);
+    return kNoReason;
+}
+
+
+void CardinalitySat::explain(uint32_t reason, Lit l, std::vector<Lit>& out) {
+    out.clear();
+    if (!(reason & kCardinality)) {
+        auto& c = clauses_[reason];
+        for(uint32_t i = 0; i < c.size; ++i)
+            if (clause_lits_[c.begin + i] != l)
+                out.push_back(clause_lits_[c.begin + i]);
+        return;
+    }
+
+    // Variables of the constraint with the value that forced "l", assigned
+    // before it; for a conflict, all variables with the excessive value.
+    auto& c = cards_[reason & ~kCardinality];
+    int8_t value;
+    uint32_t before;
+    if (l == kNoLit) {
+        value = c.trues > c.hi;
+        before = trail_.size();
+    } else {
+        value = l & 1; // the opposite of the implied one
+        before = trail_pos_[var(l)];
+    }
+
+    for(uint32_t i = 0; i < c.size; ++i) {
+        auto v = card_vars_[c.begin + i];
+        if (assigns_[v] == value and trail_pos_[v] < before)
+            out.push_back(lit(v, !value));
+    }
+}
+
+
+void CardinalitySat::analyze(uint32_t conflict, std::vector<Lit>& learnt, uint32_t& backtrack_level) {
+    // first unique implication point
+    learnt.assign(1, kNoLit);
+    size_t path{};
+    Lit p = kNoLit;
+    auto index = trail_.size();
+    auto reason = conflict;
+    do {
+        explain(reason, p, reason_lits_);
+        for(auto q: reason_lits_) {
+            auto v = var(q);
+            if (seen_[v] or !level_[v])
+                continue;
+
+            seen_[v] = 1;
+            bump(v);
+            if (level_[v] >= level())
+                ++path;
+            else
+                learnt.push_back(q);
+        }
+
+        while(!seen_[var(trail_[--index])]);
+        p = trail_[index];
+        reason = reason_[var(p)];
+        seen_[var(p)] = 0;
+    } while(--path);
+    learnt[0] = p ^ 1;
+
+    // the clause becomes asserting at the second highest level in it
+    backtrack_level = 0;
+    for(size_t i = 1; i < learnt.size(); ++i) {
+        seen_[var(learnt[i])] = 0;
+        if (level_[var(learnt[i])] > backtrack_level) {
+            backtrack_level = level_[var(learnt[i])];
+            std::swap(learnt[1], learnt[i]);
+        }
+    }
+}
+
+
+void CardinalitySat::learn(const std::vector<Lit>& learnt) {
+    if (learnt.size() == 1) {
+        enqueue(learnt[0], kNoReason);
+        return;
+    }
+
+    auto id = uint32_t(clauses_.size());
+    clauses_.push_back({uint32_t(clause_lits_.size()), uint32_t(learnt.size())});
+    clause_lits_.insert(clause_lits_.end(), learnt.begin(), learnt.end());
+    watches_[learnt[0]].push_back(id);
+    watches_[learnt[1]].push_back(id);
+    enqueue(learnt[0], id);
+}
+
+
+CardinalitySat::Result CardinalitySat::solve(const Lit* assumptions, size_t nr) {
+    ++stats_.solves;
+    backtrack(0);
+    if (!ok_ or propagate() != kNoReason) {
+        ok_ = false;
+        return Result::kUnsat;
+    }
+
+    size_t conflicts{}, restarts{};
+    size_t next_restart = kRestartUnit;
+    while(true) {
+        auto conflict = propagate();
+        if (conflict != kNoReason) {
+            ++stats_.conflicts;
+            if (!level()) {
+                ok_ = false;
+                return Result::kUnsat;
+            }
+
+            uint32_t backtrack_level;
+            analyze(conflict, learnt_, backtrack_level);
+            backtrack(backtrack_level);
+            learn(learnt_);
+            bump_by_ /= kActivityDecay;
+
+            if (++conflicts >= budget_) {
+                backtrack(0);
+                return Result::kUnknown;
+            }
+            continue;
+        }
+
+        if (conflicts >= next_restart) {
+            backtrack(0);
+            next_restart = conflicts + kRestartUnit * luby(++restarts);
+        }
+
+        // assumptions are the first decisions
+        if (level() < nr) {
+            auto a = assumptions[level()];
+            if (is_false(a)) {
+                backtrack(0);
+                return Result::kUnsat;
+            }
+
+            trail_lim_.push_back(trail_.size());
+            if (!is_true(a))
+                enqueue(a, kNoReason);
+            continue;
+        }
+
+        auto v = pick_branch();
+        if (v == kNoVar) {
+            for(Var u = 0; u < vars_nr_; ++u)
+                model_[u] = assigns_[u];
+            backtrack(0);
+            return Result::kSat;
+        }
+
+        ++stats_.decisions;
+        trail_lim_.push_back(trail_.size());
+        enqueue(lit(v, phase_[v]), kNoReason);
+    }
+}
+
+
+bool CardinalitySat::fix(Var v, bool value) {
+    backtrack(0);
+    auto l = lit(v, value);
+    if (!ok_ or is_false(l))
+        return ok_ = false;
+    if (is_true(l))
+        return true;
+
+    enqueue(l, kNoReason);
+    ok_ = propagate() == kNoReason;
+    return ok_;
+}
+
+
+CardinalitySat::Var CardinalitySat::pick_branch() {
+    while(!heap_.empty()) {
+        auto v = heap_pop();
+        if (assigns_[v] < 0)
+            return v;
+    }
+    return kNoVar;
+}
+
+
+void CardinalitySat::bump(Var v) {
+    if ((activity_[v] += bump_by_) > 1e100) {
+        for(auto& a: activity_)
+            a *= 1e-100;
+        bump_by_ *= 1e-100;
+    }
+
+    if (heap_pos_[v] >= 0)
+        heap_up(heap_pos_[v]);
+}
+
+
+void CardinalitySat::heap_up(size_t i) {
+    auto v = heap_[i];
+    while(i) {
+        auto parent = (i - 1) / 2;
+        if (activity_[heap_[parent]] >= activity_[v])
+            break;
+        heap_[i] = heap_[parent];
+        heap_pos_[heap_[i]] = i;
+        i = parent;
+    }
+    heap_[i] = v;
+    heap_pos_[v] = i;
+}
+
+
+void CardinalitySat::heap_down(size_t i) {
+    auto v = heap_[i];
+    while(true) {
+        auto child = 2 * i + 1;
+        if (child >= heap_.size())
+            break;
+        if (child + 1 < heap_.size() and activity_[heap_[child + 1]] > activity_[heap_[child]])
+            ++child;
+        if (activity_[heap_[child]] <= activity_[v])
+            break;
+        heap_[i] = heap_[child];
+        heap_pos_[heap_[i]] = i;
+        i = child;
+    }
+    heap_[i] = v;
+    heap_pos_[v] = i;
+}
+
+
+void CardinalitySat::heap_insert(Var v) {
+    heap_pos_[v] = heap_.size();
+    heap_.push_back(v);
+    heap_up(heap_.size() - 1);
+}
+
+
+CardinalitySat::Var CardinalitySat::heap_pop() {
+    auto v = heap_[0];
+    heap_pos_[v] = -1;
+    heap_[0] = heap_.back();
+    heap_.pop_back();
+    if (!heap_.empty()) {
+        heap_pos_[heap_[0]] = 0;
+        heap_down(0);
+    }
+    return v;
+}
+
+} // namespace miner
@@ -0,0 +1,116 @@
+#pragma once
+
+namespace miner {
+
+//
+// CDCL SAT solver over cardinality constraints "lo <= number of true
+// variables <= hi", which is what number cells are, plus clauses it learns
+// from conflicts. Cardinality constraints propagate natively from counters of
+// their true and false variables and explain implied values lazily from the
+// trail. Assumptions make it incremental: one instance decides every
+// variable of a frontier component, and clauses learned by one probe speed up
+// the next ones.
+//
+class CardinalitySat {
+public:
+    using Var = uint32_t;
+    using Lit = uint32_t; // 2 * var, plus 1 if negated
+
+    static Lit lit(Var v, bool value) { return 2 * v + !value; }
+
+    enum class Result : uint8_t {
+        kSat,
+        kUnsat,
+        kUnknown, // ran out of conflict budget
+    };
+
+    struct Stats {
+        size_t solves{};
+        size_t conflicts{};
+        size_t decisions{};
+        size_t propagations{};
+    };
+
+    void reset(size_t vars_nr);
+    void add(const Var* vars, size_t nr, uint32_t lo, uint32_t hi);
+
+    // Looks for an assignment with the given literals true; in case of kSat,
+    // value() tells the assignment.
+    Result solve(const Lit* assumptions = nullptr, size_t nr = 0);
+    bool value(Var v) const { return model_[v]; }
+
+    // Adds a unit fact. Returns false if it makes the problem unsatisfiable.
+    bool fix(Var, bool value);
+
+    void set_conflict_budget(size_t v) { budget_ = v; } // per solve()
+    const Stats& stats() const { return stats_; }
+
+private:
+    static constexpr uint32_t kNoReason = ~uint32_t{};
+    static constexpr uint32_t kCardinality = uint32_t{1} << 31; // reason tag
+    static constexpr Lit kNoLit = ~Lit{};
+    static constexpr Var kNoVar = ~Var{};
+
+    struct Cardinality {
+        uint32_t begin, size; // in card_vars_
+        uint32_t lo, hi;
+        uint32_t trues{}, falses{};
+    };
+
+    struct Clause {
+        uint32_t begin, size; // in clause_lits_
+    };
+
+    static Var var(Lit l) { return l >> 1; }
+    bool is_true(Lit l) const { return assigns_[var(l)] == int8_t(!(l & 1)); }
+    bool is_false(Lit l) const { return assigns_[var(l)] == int8_t(l & 1); }
+    uint32_t level() const { return trail_lim_.size(); }
+
+    void enqueue(Lit, uint32_t reason);
+    uint32_t propagate(); // returns the conflict's reason or kNoReason
+    uint32_t propagate_cardinality(uint32_t c);
+    uint32_t propagate_clauses(Lit falsified);
+    // false literals which imply "l" through "reason", or which conflict if l == kNoLit
+    void explain(uint32_t reason, Lit l, std::vector<Lit>& out);
+    void analyze(uint32_t conflict, std::vector<Lit>& learnt, uint32_t& backtrack_level);
+    void learn(const std::vector<Lit>&);
+    void backtrack(uint32_t level);
+    Var pick_branch();
+
+    // decision order: binary max-heap by activity
+    void heap_up(size_t i);
+    void heap_down(size_t i);
+    void heap_insert(Var);
+    Var heap_pop();
+    void bump(Var);
+
+    size_t vars_nr_{};
+    std::vector<int8_t> assigns_; // -1 if unassigned
+    std::vector<uint8_t> model_;
+    std::vector<uint8_t> phase_;  // last value of each variable
+    std::vector<uint32_t> level_, reason_, trail_pos_;
+    std::vector<Lit> trail_;
+    std::vector<uint32_t> trail_lim_;
+    size_t qhead_{};
+
+    std::vector<Cardinality> cards_;
+    std::vector<Var> card_vars_;
+    std::vector<std::vector<uint32_t>> occurs_; // cardinalities by variable
+
+    std::vector<Clause> clauses_;
+    std::vector<Lit> clause_lits_;
+    std::vector<std::vector<uint32_t>> watches_; // clauses by watched literal
+
+    std::vector<double> activity_;
+    double bump_by_{1};
+    std::vector<Var> heap_;
+    std::vector<int32_t> heap_pos_; // -1 if not in heap
+
+    std::vector<uint8_t> seen_;
+    std::vector<Lit> reason_lits_, learnt_;
+    bool ok_{true};
+    size_t budget_{100000};
+    Stats stats_;
+};
+
+} // namespace miner
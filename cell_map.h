@@ -0,0 +1,100 @@
+#pragma once
+
+#include "field.h"
+
+namespace miner {
+
+//
+// Map from cells of a board to small unsigned values (LP columns, node ids)
+// without hashing: a flat array indexed by CellIndex, allocated in pages as
+// cells get touched, and a list of the cells set, so that clear() costs as
+// much as the insertions did. Pages are found through a directory of page
+// tables, so that a lookup is three array reads and a huge board costs a
+// pointer per 2^24 cells.
+//
+template<class T>
+class CellMap {
+public:
+    static_assert(std::is_unsigned<T>::value, "CellMap values must be unsigned");
+    static constexpr T kNone = T(-1);
+
+    // Forgets all values, and makes Location keys cells of a board this wide.
+    void clear(size_t cols) {
+        if (cols != cols_)
+            dir_.clear();
+        cols_ = cols;
+        clear();
+    }
+
+    void clear() {
+        for(auto i: keys_)
+            slot(i) = kNone;
+        keys_.clear();
+    }
+
+    CellIndex index(Location l) const { return CellIndex{l.row} * cols_ + l.col; }
+    Location location(CellIndex i) const { return {i / cols_, i % cols_}; }
+
+    // value of a cell, or kNone
+    T find(CellIndex i) const {
+        auto d = i >> (2 * kPageBits);
+        if (d >= dir_.size() or !dir_[d])
+            return kNone;
+        auto& page = dir_[d][i >> kPageBits & kPageMask];
+        return page ? page[i & kPageMask] : kNone;
+    }
+    T find(Location l) const { return find(index(l)); }
+    bool count(Location l) const { return find(l) != kNone; }
+
+    // Gives a cell value v unless it has one. Returns true if it didn't.
+    bool emplace(Location l, T v) {
+        auto i = index(l);
+        auto& s = slot(i);
+        if (s != kNone)
+            return false;
+        s = v;
+        keys_.push_back(i);
+        return true;
+    }
+
+    // Gives a cell value v, whether it had one or not. v mustn't be kNone:
+    // there is no erasing but by clear().
+    void assign(Location l, T v) {
+        auto i = index(l);
+        auto& s = slot(i);
+        if (s == kNone)
+            keys_.push_back(i);
+        s = v;
+    }
+
+    size_t cols() const { return cols_; }
+    size_t size() const { return keys_.size(); }
+    bool empty() const { return keys_.empty(); }
+    const std::vector<CellIndex>& keys() const { return keys_; } // in order of insertion
+
+private:
+    static constexpr unsigned kPageBits = 12;
+    static constexpr CellIndex kPageMask = (CellIndex{1} << kPageBits) - 1;
+
+    using Page = std::unique_ptr<T[]>;
+
+    T& slot(CellIndex i) {
+        auto d = i >> (2 * kPageBits);
+        if (d >= dir_.size())
+            dir_.resize(d + 1);
+        if (!dir_[d])
+            dir_[d].reset(new Page[kPageMask + 1]);
+        auto& page = dir_[d][i >> kPageBits & kPageMask];
+        if (!page) {
+            page.reset(new T[kPageMask + 1]);
+            std::fill(page.get(), page.get() + kPageMask + 1, kNone);
+        }
+        return page[i & kPageMask];
+    }
+
+    size_t cols_{};
+    std::vector<std::unique_ptr<Page[]>> dir_; // page tables of 2^kPageBits pages
+    std::vector<CellIndex> keys_;
+};
+
+} // namespace miner
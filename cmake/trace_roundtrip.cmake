@@ -0,0 +1,29 @@
+# Plays a few games under miner_batch --trace and replays each trace with
+# miner_replay, which fails unless the traced deductions give the board the
+# solver ended with.
+#
+# cmake -DBATCH=miner_batch -DREPLAY=miner_replay -DSOLVER=NAME -DDIR=DIR
+#       -P trace_roundtrip.cmake
+
+file(REMOVE_RECURSE ${DIR})
+file(MAKE_DIRECTORY ${DIR})
+
+execute_process(
+  COMMAND ${BATCH} --seeds 1:20 --threads 1 --solver ${SOLVER} --trace ${DIR}
+          --format csv --out ${DIR}/batch.csv
+  RESULT_VARIABLE rv)
+IF (rv)
+  message(FATAL_ERROR "miner_batch --solver ${SOLVER} failed: ${rv}")
+ENDIF()
+
+file(GLOB traces ${DIR}/*.trace)
+IF (NOT traces)
+  message(FATAL_ERROR "miner_batch --solver ${SOLVER} wrote no traces to ${DIR}")
+ENDIF()
+
+foreach(trace ${traces})
+  execute_process(COMMAND ${REPLAY} ${trace} RESULT_VARIABLE rv OUTPUT_VARIABLE out)
+  IF (rv)
+    message(FATAL_ERROR "miner_replay ${trace} failed: ${rv}\n${out}")
+  ENDIF()
+endforeach()
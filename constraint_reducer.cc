@@ -0,0 +1,194 @@
+#include "constraint_reducer.h"
+
+namespace miner {
+
+void ConstraintReducer::clear(size_t board_cols) {
+    ids_.clear(board_cols);
+    cells_.clear();
+    states_.clear();
+    for(auto& v: cell_constraints_)
+        v.clear();
+    constraints_.clear();
+    queue_.clear();
+}
+
+
+uint32_t ConstraintReducer::cell_id(Location l) {
+    if (ids_.emplace(l, cells_.size())) {
+        cells_.push_back(l);
+        states_.push_back(CellState::kUnknown);
+        if (cell_constraints_.size() < cells_.size())
+            cell_constraints_.resize(cells_.size());
+    }
+
+    return ids_.find(l);
+}
+
+
+void ConstraintReducer::add(uint8_t mines_nr, const Location* cells, uint8_t nr) {
+    I_ASSERT(nr <= kMaxCells, EX_LOG("too many cells in a constraint: " << int(nr)));
+
+    Constraint c;
+    c.mines_nr = mines_nr;
+    c.nr = nr;
+    for(uint8_t i = 0; i < nr; ++i)
+        c.cells[i] = cell_id(cells[i]);
+    std::sort(c.cells.begin(), c.cells.begin() + nr);
+
+    auto id = uint32_t(constraints_.size());
+    for(uint8_t i = 0; i < nr; ++i)
+        cell_constraints_[c.cells[i]].push_back(id);
+    constraints_.push_back(c);
+    enqueue(id);
+}
+
+
+void ConstraintReducer::enqueue(uint32_t c) {
+    if (!constraints_[c].queued) {
+        constraints_[c].queued = true;
+        queue_.push_back(c);
+    }
+}
+
+
+// Drops already resolved cells from a constraint.
+bool ConstraintReducer::normalize(Constraint& c) {
+    uint8_t nr{};
+    for(uint8_t i = 0; i < c.nr; ++i) {
+        switch(states_[c.cells[i]]) {
+        case CellState::kUnknown:
+            c.cells[nr++] = c.cells[i];
+            break;
+
+        case CellState::kMined:
+            --c.mines_nr;
+            break;
+
+        case CellState::kSafe:
+            break;
+        }
+    }
+
+    c.nr = nr;
+    return c.mines_nr >= 0 and c.mines_nr <= c.nr;
+}
+
+
+bool ConstraintReducer::force(uint32_t cell, bool mined, std::vector<Deduction>& out) {
+    auto s = mined ? CellState::kMined : CellState::kSafe;
+    if (states_[cell] != CellState::kUnknown)
+        return states_[cell] == s;
+
+    states_[cell] = s;
+    out.push_back({cells_[cell], mined});
+    for(auto c: cell_constraints_[cell])
+        enqueue(c);
+    return true;
+}
+
+
+bool ConstraintReducer::force_all(
+  const uint32_t* cells, uint8_t nr, bool mined, std::vector<Deduction>& out) {
+    for(uint8_t i = 0; i < nr; ++i)
+        if (!force(cells[i], mined, out))
+            return false;
+    return true;
+}
+
+
+bool ConstraintReducer::check_pair(uint32_t ai, uint32_t bi, std::vector<Deduction>& out) {
+    auto& a = constraints_[ai];
+    auto& b = constraints_[bi];
+    if (!normalize(b))
+        return false;
+
+    // split into A\B, B\A and A&B; cells are sorted
+    uint32_t only_a[kMaxCells], only_b[kMaxCells], both[kMaxCells];
+    uint8_t na{}, nb{}, ni{};
+    uint8_t i{}, j{};
+    while(i < a.nr or j < b.nr) {
+        if (j == b.nr or (i < a.nr and a.cells[i] < b.cells[j])) {
+            only_a[na++] = a.cells[i++];
+        } else if (i == a.nr or b.cells[j] < a.cells[i]) {
+            only_b[nb++] = b.cells[j++];
+        } else {
+            both[ni++] = a.cells[i++];
+            ++j;
+        }
+    }
+
+    if (!ni)
+        return true;
+
+    // bounds on the number of mines in A&B implied by both constraints
+    int lo = std::max({0, a.mines_nr - na, b.mines_nr - nb});
+    int hi = std::min({int(ni), a.mines_nr, b.mines_nr});
+    if (lo > hi)
+        return false;
+
+    if (lo == ni and !force_all(both, ni, true, out))
+        return false;
+    if (!hi and !force_all(both, ni, false, out))
+        return false;
+
+    // A\B holds [mines_nr - hi, mines_nr - lo] mines, likewise B\A
+    if (a.mines_nr - hi == na and !force_all(only_a, na, true, out))
+        return false;
+    if (a.mines_nr == lo and !force_all(only_a, na, false, out))
+        return false;
+    if (b.mines_nr - hi == nb and !force_all(only_b, nb, true, out))
+        return false;
+    if (b.mines_nr == lo and !force_all(only_b, nb, false, out))
+        return false;
+
+    return true;
+}
+
+
+bool ConstraintReducer::reduce(std::vector<Deduction>& out) {
+    seen_.resize(constraints_.size());
+
+    while(!queue_.empty()) {
+        auto ci = queue_.back();
+        queue_.pop_back();
+        constraints_[ci].queued = false;
+
+        auto& c = constraints_[ci];
+        if (!normalize(c))
+            return false;
+        if (!c.nr)
+            continue;
+
+        // a single constraint
+        if (!c.mines_nr or c.mines_nr == c.nr) {
+            if (!force_all(c.cells.data(), c.nr, c.mines_nr != 0, out))
+                return false;
+            continue;
+        }
+
+        // pairs of overlapping constraints
+        if (!++stamp_)
+            std::fill(seen_.begin(), seen_.end(), stamp_++);
+        seen_[ci] = stamp_;
+
+        // copy: forced cells change c.cells and cell_constraints_ may be walked
+        auto cells = c.cells;
+        auto nr = c.nr;
+        for(uint8_t i = 0; i < nr; ++i) {
+            for(auto other: cell_constraints_[cells[i]]) {
+                if (seen_[other] == stamp_)
+                    continue;
+                seen_[other] = stamp_;
+
+                if (!normalize(constraints_[ci]))
+                    return false;
+                if (!check_pair(ci, other, out))
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace miner
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "cell_map.h"
+
+namespace miner {
+
+//
+// Native deduction engine for number constraints "sum of these unknown
+// cells == N". Resolves cells forced by a single constraint (N == 0 or
+// N == number of cells) and by a pair of overlapping constraints: with
+// A, B, I = A&B, the number of mines in I is bounded by both constraints,
+// which forces A\B, B\A or I when a bound is tight. This covers subset,
+// superset and difference patterns without building an LP.
+//
+class ConstraintReducer {
+public:
+    struct Deduction {
+        Location location;
+        bool mined;
+    };
+
+    void clear(size_t board_cols); // cells are on a board this wide
+    void add(uint8_t mines_nr, const Location* cells, uint8_t nr);
+
+    // Applies the rules until nothing changes, appending forced cells to "out".
+    // Returns false if constraints contradict each other.
+    bool reduce(std::vector<Deduction>& out);
+
+private:
+    static constexpr uint8_t kMaxCells = 8;
+
+    enum class CellState : int8_t {
+        kUnknown = -1,
+        kSafe = 0,
+        kMined = 1,
+    };
+
+    struct Constraint {
+        int mines_nr{};
+        uint8_t nr{};
+        std::array<uint32_t, kMaxCells> cells; // sorted cell ids
+        bool queued{};
+    };
+
+    uint32_t cell_id(Location);
+    bool normalize(Constraint&);
+    bool force(uint32_t cell, bool mined, std::vector<Deduction>&);
+    bool force_all(const uint32_t* cells, uint8_t nr, bool mined, std::vector<Deduction>&);
+    bool check_pair(uint32_t a, uint32_t b, std::vector<Deduction>&);
+    void enqueue(uint32_t c);
+
+    CellMap<uint32_t> ids_;
+    std::vector<Location> cells_;
+    std::vector<CellState> states_;
+    std::vector<std::vector<uint32_t>> cell_constraints_; // constraints by cell id
+    std::vector<Constraint> constraints_;
+    std::vector<uint32_t> queue_;
+    std::vector<uint32_t> seen_; // per constraint stamp, avoids re-checking a pair
+    uint32_t stamp_{};
+};
+
+} // namespace miner
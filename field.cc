@@ -1,32 +1,84 @@
+#include "bit_kernels.h"
 #include "field.h"
 
 namespace miner {
 
-void Field::reset(size_t rows, size_t cols) {
+void Field::reset(size_t rows, size_t cols, PlaneStorage storage) {
+    I_ASSERT(rows <= (uint64_t{1} << 32) and cols <= (uint64_t{1} << 32),
+             EX_LOG("board of " << rows << "x" << cols << " is too large for Location"));
     mines_nr_ = 0;
     rows_ = rows;
     cols_ = cols;
-    data_.resize(rows_ * cols_);
-    std::fill(data_.begin(), data_.end(), false);
+    generator_.reset();
+    mined_.reset(rows_, cols_, storage);
+    counts_.reset(rows_, cols_, mined_.tiled() ? PlaneStorage::kTiled : PlaneStorage::kDense);
 }
 
 
-size_t Field::to_index(Location l) const {
-    return l.row * cols_ + l.col;
+// Rebuilds neighbor counts from scratch with a 3x3 box sum over unpacked rows.
+// Tiled fields are sparse: counts are added around each mine instead.
+void Field::update_counts() {
+    counts_.reset(rows_, cols_, mined_.tiled() ? PlaneStorage::kTiled : PlaneStorage::kDense);
+    if (!rows_ or !cols_)
+	return;
+    
+    if (mined_.tiled()) {
+	mined_.for_each_block([&](size_t row0, size_t rows, size_t w0, size_t words) {
+	    for(auto row = row0; row < row0 + rows; ++row)
+		for(auto w = w0; w < w0 + words; ++w)
+		    for(uint64_t bits = mined_.word(row, w); bits; bits &= bits - 1)
+			add_to_counts({row, w * 64 + __builtin_ctzll(bits)}, 1);
+	});
+	return;
+    }
+    
+    // rows of 0/1 bytes, padded with one zero byte on each side
+    std::vector<uint8_t> above(cols_ + 2), cur(cols_ + 2), below(cols_ + 2);
+    kernels::unpack_bits(mined_.row_data(0), cols_, cur.data() + 1);
+    
+    for(size_t row = 0; row < rows_; ++row) {
+	if (row + 1 < rows_)
+	    kernels::unpack_bits(mined_.row_data(row + 1), cols_, below.data() + 1);
+	else
+	    std::fill(below.begin(), below.end(), 0);
+	
+	kernels::box_sum3(above.data() + 1, cur.data() + 1, below.data() + 1,
+                          counts_.row_bytes(row), cols_);
+	above.swap(cur);
+	cur.swap(below);
+    }
+}
+
+
+void Field::add_to_counts(Location l, int d) {
+    for(size_t row = l.row > 0 ? l.row - 1 : 0; row <= std::min(rows_ - 1, l.row + size_t{1}); ++row)
+	for(size_t col = l.col > 0 ? l.col - 1 : 0; col <= std::min(cols_ - 1, l.col + size_t{1}); ++col)
+	    if (row != l.row or col != l.col)
+		counts_.set(row, col, counts_.get(row, col) + d);
 }
 
 
 void Field::mark_mined(Location l, bool v) {
-    auto idx = to_index(l);
-    if (data_[idx]) {
+    std::unique_lock<std::mutex> lock;
+    if (generator_) {
+        // counts around the cell must be there before they are changed
+        lock = std::unique_lock<std::mutex>(lazy_mutex_);
+        for(size_t row = l.row > 0 ? l.row - 1 : 0; row <= std::min(rows_ - 1, l.row + size_t{1}); ++row)
+            for(size_t col = l.col > 0 ? l.col - 1 : 0; col <= std::min(cols_ - 1, l.col + size_t{1}); ++col)
+                count_tile(row / FieldGenerator::kTileSize, col / FieldGenerator::kTileSize);
+    }
+    
+    if (mined_.get(l.row, l.col)) {
 	if (!v) {
-	    data_[idx] = false;
+	    mined_.set(l.row, l.col, 0);
+	    add_to_counts(l, -1);
 	    mines_nr_--;
 	}
 	
     } else {
 	if (v) {
-	    data_[idx] = true;
+	    mined_.set(l.row, l.col, 1);
+	    add_to_counts(l, 1);
 	    ++mines_nr_;
 	}
     }
@@ -34,52 +86,138 @@ void Field::mark_mined(Location l, bool v) {
 
 
 void Field::gen_random(size_t rows, size_t cols, size_t mines_nr) {
-    srand48(time(nullptr));
-    reset(rows, cols);
+    gen_random(rows, cols, mines_nr, time(nullptr));
+}
+
+
+void Field::gen_random(size_t rows, size_t cols, size_t mines_nr, long seed, PlaneStorage storage) {
+    reset(rows, cols, storage);
+    seed_ = seed;
 
     // TODO: throw exception?
     if (mines_nr >= rows * cols)
 	return;
     
-    // For low fill rates (<= 30%), this should work well.
     mines_nr_ = mines_nr;
-    while(mines_nr) {
-	Location l{size_t(drand48() * rows_), size_t(drand48() * cols_)};
-        if (is_mined(l))
-            continue;
-        
-        data_[to_index(l)] = true;
-        --mines_nr;
-    }
+    FieldGenerator generator{rows, cols, mines_nr, uint64_t(seed)};
+    std::vector<uint32_t> tile_mines;
+    generator.tile_mines(tile_mines);
+    
+    // Tiles are a word wide, so threads generating different tiles of a
+    // dense plane write different words. Tiled planes allocate as they go.
+    auto generate = [&](size_t tile_row0, size_t tile_row1) {
+	uint64_t words[FieldGenerator::kTileSize];
+	for(auto t = tile_row0 * generator.tile_cols(); t < tile_row1 * generator.tile_cols(); ++t) {
+	    generator.tile(t, tile_mines[t], words);
+	    auto row0 = t / generator.tile_cols() * FieldGenerator::kTileSize;
+	    auto w = t % generator.tile_cols();
+	    for(size_t r = 0; r < FieldGenerator::kTileSize and row0 + r < rows_; ++r)
+		mined_.set_word(row0 + r, w, words[r]);
+	}
+    };
+    
+    size_t threads_nr = mined_.tiled() ? 1 : std::min<size_t>(
+      std::max(1u, std::thread::hardware_concurrency()), generator.tiles_nr() / 64 + 1);
+    std::vector<std::thread> threads;
+    for(size_t i = 1; i < threads_nr; ++i)
+	threads.emplace_back(generate, generator.tile_rows() * i / threads_nr,
+			     generator.tile_rows() * (i + 1) / threads_nr);
+    generate(0, generator.tile_rows() / threads_nr);
+    for(auto& t: threads)
+	t.join();
+    
+    update_counts();
 }
 
 
-uint8_t Field::nearby_mines_nr(Location l) const {
-    uint8_t nr{};
+void Field::gen_lazy(size_t rows, size_t cols, size_t mines_nr, long seed) {
+    reset(rows, cols, PlaneStorage::kTiled);
+    seed_ = seed;
+    if (mines_nr >= rows * cols)
+	return;
     
-    if (l.row > 0) {
-	if (l.col > 0)
-            nr += is_mined({l.row - 1, l.col - 1});
-	nr += is_mined({l.row - 1, l.col});
-	if (l.col < cols_ - 1)
-            nr += is_mined({l.row - 1, l.col + 1});
+    mines_nr_ = mines_nr;
+    start_lazy(mines_nr);
+}
+
+
+// Makes tiles be generated on demand from seed_, overwriting what they have.
+void Field::start_lazy(size_t generated_mines_nr) {
+    generator_.reset(new FieldGenerator{rows_, cols_, generated_mines_nr, uint64_t(seed_)});
+    generated_.reset(generator_->tile_rows(), generator_->tile_cols(), PlaneStorage::kTiled);
+    counted_.reset(generator_->tile_rows(), generator_->tile_cols(), PlaneStorage::kTiled);
+}
+
+
+unsigned Field::lazy_get(Location l, bool count) const {
+    std::lock_guard<std::mutex> lock(lazy_mutex_);
+    auto tile_row = l.row / FieldGenerator::kTileSize;
+    auto tile_col = l.col / FieldGenerator::kTileSize;
+    if (!count) {
+	generate_tile(tile_row, tile_col);
+	return mined_.get(l.row, l.col);
     }
+    count_tile(tile_row, tile_col);
+    return counts_.get(l.row, l.col);
+}
+
+
+void Field::generate_tile(size_t tile_row, size_t tile_col) const {
+    if (generated_.get(tile_row, tile_col))
+	return;
+    
+    auto t = tile_row * generator_->tile_cols() + tile_col;
+    uint64_t words[FieldGenerator::kTileSize];
+    generator_->tile(t, generator_->tile_mines(t), words);
+    auto row0 = tile_row * FieldGenerator::kTileSize;
+    for(size_t r = 0; r < FieldGenerator::kTileSize and row0 + r < rows_; ++r)
+	mined_.set_word(row0 + r, tile_col, words[r]);
+    generated_.set(tile_row, tile_col, 1);
+}
+
+
+// Neighbor counts of a tile, from the mines of it and of the tiles around.
+void Field::count_tile(size_t tile_row, size_t tile_col) const {
+    if (counted_.get(tile_row, tile_col))
+	return;
     
-    if (l.col > 0)
-        nr += is_mined({l.row, l.col-1});
+    for(auto tr = tile_row > 0 ? tile_row - 1 : 0; tr <= std::min(generated_.rows() - 1, tile_row + 1); ++tr)
+	for(auto tc = tile_col > 0 ? tile_col - 1 : 0; tc <= std::min(generated_.cols() - 1, tile_col + 1); ++tc)
+	    generate_tile(tr, tc);
     
-    if (l.col < cols_ - 1)
-        nr += is_mined({l.row, l.col + 1});
+    // rows of 0/1 bytes for the tile's columns, padded with a column on each side
+    constexpr size_t kTile = FieldGenerator::kTileSize;
+    auto unpack = [&](size_t row, uint8_t* out) {
+	std::fill(out, out + kTile + 2, 0);
+	if (row >= rows_)
+	    return;
+	uint64_t w = mined_.word(row, tile_col);
+	kernels::unpack_bits(&w, kTile, out + 1);
+	if (tile_col > 0)
+	    out[0] = mined_.word(row, tile_col - 1) >> 63;
+	if (tile_col + 1 < mined_.words_per_row())
+	    out[kTile + 1] = mined_.word(row, tile_col + 1) & 1;
+    };
     
-    if (l.row < rows_ - 1) {
-	if (l.col > 0)
-            nr += is_mined({l.row + 1, l.col - 1});
-	nr += is_mined({l.row + 1, l.col});
-	if (l.col < cols_ - 1)
-            nr += is_mined({l.row + 1, l.col + 1});
+    uint8_t above[kTile + 2], cur[kTile + 2], below[kTile + 2];
+    uint64_t sums[kTile / 8];
+    auto width = std::min(kTile, cols_ - tile_col * kTile); // counts past the last column stay 0
+    auto row0 = tile_row * kTile;
+    if (row0 > 0)
+	unpack(row0 - 1, above);
+    else
+	std::fill(above, above + kTile + 2, 0);
+    unpack(row0, cur);
+    for(auto row = row0; row < std::min(rows_, row0 + kTile); ++row) {
+	unpack(row + 1, below);
+	std::fill(sums, sums + kTile / 8, 0);
+	kernels::box_sum3(above + 1, cur + 1, below + 1, reinterpret_cast<uint8_t*>(sums), width);
+	for(size_t w = 0; w < kTile / 8; ++w)
+	    counts_.set_word(row, tile_col * 8 + w, sums[w]);
+	std::copy(cur, cur + kTile + 2, above);
+	std::copy(below, below + kTile + 2, cur);
     }
-    
-    return nr;
+    counted_.set(tile_row, tile_col, 1);
 }
 
 } // namespace miner
@@ -1,14 +1,22 @@
 #pragma once
 
+#include "field_generator.h"
+#include "packed_plane.h"
+
 namespace miner {
 
-// Represents a coordinate on a field.
+// Linear index of a cell, row * cols + col; see Field::index().
+using CellIndex = uint64_t;
+
+// Represents a coordinate on a field. Boards have less than 2^32 rows and
+// columns, so coordinates are 32-bit: a Location is 8 bytes, and the arrays of
+// them in neighborhoods and queues are half the size.
 struct Location {
     Location() : row{}, col{} {}
-    Location(size_t _row, size_t _col) : row{_row}, col{_col} {}
+    Location(size_t _row, size_t _col) : row{uint32_t(_row)}, col{uint32_t(_col)} {}
     
-    size_t row{};
-    size_t col{};
+    uint32_t row{};
+    uint32_t col{};
     
     bool operator==(const Location& other) const {
         return row == other.row and col == other.col;
@@ -22,7 +30,7 @@ namespace std {
 template<>
 struct hash<miner::Location> {
     std::size_t operator()(const miner::Location& l) const {
-	return qHash(l.col, qHash(l.row, 0));
+	return (uint64_t(l.row) << 32 | l.col) * 0x9e3779b97f4a7c15ull >> 16;
     }
 };
 
@@ -38,24 +46,56 @@ namespace miner {
 //
 // Represents a true mine field.
 //
+// Random fields are made by FieldGenerator, so a seed always gives the same
+// field. A lazy field (gen_lazy()) works out the mines of a 64x64 tile, and
+// the neighbor counts of one, when a cell of it is first asked about; other
+// tiles cost nothing. Queries of a lazy field lock a mutex, since the solver
+// and the GUI make them from different threads.
+//
 class Field {
 public:
     void gen_random(size_t rows, size_t cols, size_t mines_nr);
-    void reset(size_t rows, size_t cols);
+    void gen_random(size_t rows, size_t cols, size_t mines_nr, long seed, // reproducible
+                    PlaneStorage = PlaneStorage::kAuto);
+    void gen_lazy(size_t rows, size_t cols, size_t mines_nr, long seed); // always tiled
+    void reset(size_t rows, size_t cols, PlaneStorage = PlaneStorage::kAuto);
     void mark_mined(Location, bool); // for manual minefield control; maintains mines_nr
-    bool is_mined(Location l) const { return data_[l.row * cols_ + l.col]; }
-    uint8_t nearby_mines_nr(Location) const;
+    CellIndex index(Location l) const { return CellIndex{l.row} * cols_ + l.col; }
+    Location location(CellIndex i) const { return {i / cols_, i % cols_}; }
+    bool is_mined(Location l) const {
+        return generator_ ? lazy_get(l, false) : mined_.get(l.row, l.col);
+    }
+    uint8_t nearby_mines_nr(Location l) const {
+        return generator_ ? lazy_get(l, true) : counts_.get(l.row, l.col);
+    }
     size_t rows() const { return rows_; }
     size_t cols() const { return cols_; }
     size_t mines_nr() const { return mines_nr_; }
+    long seed() const { return seed_; } // of the last gen_random() or gen_lazy()
+    bool tiled() const { return mined_.tiled(); } // sparse storage of a huge field
+    bool lazy() const { return bool(generator_); }
     
 private:
-    size_t to_index(Location) const;
+    friend class BoardFile;
+    
+    void update_counts();
+    void add_to_counts(Location, int);
+    void start_lazy(size_t generated_mines_nr);
+    unsigned lazy_get(Location, bool count) const;
+    void generate_tile(size_t tile_row, size_t tile_col) const;
+    void count_tile(size_t tile_row, size_t tile_col) const;
     
     size_t mines_nr_{};
     size_t rows_{};
     size_t cols_{};
-    std::vector<bool> data_;
+    long seed_{};
+    // filled in by generate_tile() and count_tile() on lazy fields
+    mutable BitPlane mined_;
+    mutable BytePlane counts_; // number of mines around each cell
+    
+    std::unique_ptr<FieldGenerator> generator_; // of a lazy field
+    mutable std::mutex lazy_mutex_;
+    mutable BitPlane generated_, counted_;      // tiles done by generate_tile(), count_tile()
 };
 
 using FieldPtr = std::shared_ptr<Field>;
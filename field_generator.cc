@@ -0,0 +1,134 @@
+#include "field_generator.h"
+
+namespace miner {
+
+namespace {
+
+constexpr uint64_t kTileStreams = uint64_t{1} << 63; // tree nodes use the streams below
+constexpr size_t kExactSplit = 64; // larger splits use the normal approximation
+
+} // namespace
+
+
+FieldGenerator::FieldGenerator(size_t rows, size_t cols, size_t mines_nr, uint64_t seed)
+    : rows_{rows},
+      cols_{cols},
+      tile_rows_{(rows + kTileSize - 1) / kTileSize},
+      tile_cols_{(cols + kTileSize - 1) / kTileSize},
+      mines_nr_{std::min(mines_nr, rows * cols)},
+      seed_{seed} {
+}
+
+
+uint64_t FieldGenerator::cells_before(size_t tile) const {
+    if (tile >= tiles_nr())
+        return uint64_t(rows_) * cols_;
+    auto tile_row = tile / tile_cols_;
+    auto height = std::min(kTileSize, rows_ - tile_row * kTileSize);
+    return uint64_t(tile_row) * kTileSize * cols_
+        + height * std::min((tile % tile_cols_) * kTileSize, cols_);
+}
+
+
+// Number of mines which go to the left part when mines_nr of them are placed
+// uniformly on left_cells + right_cells cells.
+size_t FieldGenerator::split(uint64_t node, size_t mines_nr, uint64_t left_cells,
+                             uint64_t right_cells) const {
+    auto total = left_cells + right_cells;
+    if (!mines_nr or !left_cells)
+        return 0;
+    if (!right_cells)
+        return mines_nr;
+    if (mines_nr > total / 2) // split safe cells instead
+        return left_cells - split(node, total - mines_nr, left_cells, right_cells);
+
+    CounterRng rng{seed_, node};
+    if (mines_nr <= kExactSplit) {
+        // mine i goes to a random one of the cells left
+        size_t rv = 0;
+        for(size_t i = 0; i < mines_nr; ++i, --total)
+            if (rng.below(total, i) < left_cells - rv)
+                ++rv;
+        return rv;
+    }
+
+    double p = double(left_cells) / total;
+    double mean = mines_nr * p;
+    double sd = std::sqrt(mines_nr * p * (1 - p) * double(total - mines_nr) / (total - 1));
+    double z = std::sqrt(-2 * std::log(1 - rng.uniform(0))) * std::cos(2 * M_PI * rng.uniform(1));
+    auto rv = std::llround(mean + sd * z);
+    auto lo = mines_nr > right_cells ? int64_t(mines_nr - right_cells) : 0;
+    auto hi = int64_t(std::min<uint64_t>(mines_nr, left_cells));
+    return size_t(std::min(std::max(int64_t(rv), lo), hi));
+}
+
+
+size_t FieldGenerator::tile_mines(size_t tile) const {
+    size_t lo = 0, hi = tiles_nr(), rv = mines_nr_;
+    uint64_t node = 1;
+    while(hi - lo > 1) {
+        auto mid = lo + (hi - lo) / 2;
+        auto left = split(node, rv, cells_before(mid) - cells_before(lo),
+                          cells_before(hi) - cells_before(mid));
+        if (tile < mid) {
+            hi = mid;
+            rv = left;
+            node = 2 * node;
+        } else {
+            lo = mid;
+            rv -= left;
+            node = 2 * node + 1;
+        }
+    }
+    return rv;
+}
+
+
+void FieldGenerator::split_all(uint64_t node, size_t lo, size_t hi, size_t mines_nr,
+                               std::vector<uint32_t>& out) const {
+    if (hi - lo == 1) {
+        out[lo] = mines_nr;
+        return;
+    }
+    auto mid = lo + (hi - lo) / 2;
+    auto left = split(node, mines_nr, cells_before(mid) - cells_before(lo),
+                      cells_before(hi) - cells_before(mid));
+    split_all(2 * node, lo, mid, left, out);
+    split_all(2 * node + 1, mid, hi, mines_nr - left, out);
+}
+
+
+void FieldGenerator::tile_mines(std::vector<uint32_t>& out) const {
+    out.assign(tiles_nr(), 0);
+    if (!out.empty())
+        split_all(1, 0, out.size(), mines_nr_, out);
+}
+
+
+// Floyd's sampling of distinct cells, of the mines or of the safe cells
+// whichever are fewer.
+void FieldGenerator::tile(size_t tile, size_t mines_nr, uint64_t* rows) const {
+    auto row0 = tile / tile_cols_ * kTileSize;
+    auto col0 = tile % tile_cols_ * kTileSize;
+    size_t height = std::min(kTileSize, rows_ - row0);
+    size_t width = std::min(kTileSize, cols_ - col0);
+    size_t cells = height * width;
+    std::fill(rows, rows + kTileSize, 0);
+
+    CounterRng rng{seed_, kTileStreams + tile};
+    bool invert = mines_nr > cells / 2;
+    for(size_t j = cells - (invert ? cells - mines_nr : mines_nr); j < cells; ++j) {
+        auto c = rng.below(j + 1, j);
+        if (rows[c / width] >> (c % width) & 1)
+            c = j;
+        rows[c / width] |= uint64_t{1} << (c % width);
+    }
+
+    if (invert) {
+        auto mask = width == 64 ? ~uint64_t{} : (uint64_t{1} << width) - 1;
+        for(size_t r = 0; r < height; ++r)
+            rows[r] = ~rows[r] & mask;
+    }
+}
+
+} // namespace miner
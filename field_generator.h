@@ -0,0 +1,69 @@
+#pragma once
+
+namespace miner {
+
+//
+// Counter-based random numbers: number n of a stream is a hash of the
+// stream's key and n, so any part of any stream can be had directly, in any
+// order and from any thread, and always is the same.
+//
+class CounterRng {
+public:
+    CounterRng(uint64_t seed, uint64_t stream) : key_{mix(mix(seed) + stream)} {}
+
+    uint64_t operator()(uint64_t n) const { return mix(key_ ^ mix(n + 0x9e3779b97f4a7c15ull)); }
+    uint64_t below(uint64_t bound, uint64_t n) const { // uniform in [0, bound)
+        return uint64_t((unsigned __int128)(*this)(n) * bound >> 64);
+    }
+    double uniform(uint64_t n) const { return ((*this)(n) >> 11) * (1. / (uint64_t{1} << 53)); } // in [0, 1)
+
+private:
+    // splitmix64 finalizer
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t key_;
+};
+
+//
+// Places exactly mines_nr mines on a field, a function of the seed only. The
+// field is cut into 64x64-cell tiles, numbered row by row. Mines are split
+// between tile ranges by halving: node i of the binary tree over the ranges
+// draws how many of its mines go to its left half, with a hypergeometric
+// distribution, from stream i. Then each tile places its mines from its own
+// stream. So mines of any one tile are worked out in O(log tiles) without
+// generating the others, and tiles may be generated in parallel.
+//
+class FieldGenerator {
+public:
+    static constexpr size_t kTileSize = 64; // same as PackedPlane's tiles
+
+    FieldGenerator(size_t rows, size_t cols, size_t mines_nr, uint64_t seed);
+
+    size_t tile_rows() const { return tile_rows_; }
+    size_t tile_cols() const { return tile_cols_; }
+    size_t tiles_nr() const { return tile_rows_ * tile_cols_; }
+    size_t mines_nr() const { return mines_nr_; }
+
+    size_t tile_mines(size_t tile) const;
+    void tile_mines(std::vector<uint32_t>& out) const; // of all tiles, in O(tiles)
+
+    // Mines of a tile which has mines_nr of them (see tile_mines()): a word
+    // per row of the tile, bit i for column i of it.
+    void tile(size_t tile, size_t mines_nr, uint64_t* rows) const;
+
+private:
+    uint64_t cells_before(size_t tile) const;
+    size_t split(uint64_t node, size_t mines_nr, uint64_t left_cells, uint64_t right_cells) const;
+    void split_all(uint64_t node, size_t lo, size_t hi, size_t mines_nr, std::vector<uint32_t>& out) const;
+
+    size_t rows_, cols_;
+    size_t tile_rows_, tile_cols_;
+    size_t mines_nr_;
+    uint64_t seed_;
+};
+
+} // namespace miner
@@ -0,0 +1,79 @@
+#include "frontier.h"
+
+namespace miner {
+
+void FrontierComponents::reset(size_t board_cols) {
+    ids_.clear(board_cols);
+    parent_.clear();
+    registered_.clear();
+    cells_nr_.clear();
+    members_.clear();
+    versions_.clear();
+}
+
+
+uint32_t FrontierComponents::node(Location l) {
+    auto id = uint32_t(parent_.size());
+    if (ids_.emplace(l, id)) {
+        parent_.push_back(id);
+        registered_.push_back(false);
+        cells_nr_.push_back(0);
+        members_.emplace_back();
+        versions_.push_back(++clock_);
+    }
+
+    return ids_.find(l);
+}
+
+
+uint32_t FrontierComponents::find(uint32_t n) {
+    while(parent_[n] != n) {
+        parent_[n] = parent_[parent_[n]]; // path halving
+        n = parent_[n];
+    }
+
+    return n;
+}
+
+
+void FrontierComponents::unite(uint32_t a, uint32_t b) {
+    a = find(a);
+    b = find(b);
+    if (a == b)
+        return;
+
+    // move the smaller list of constraints
+    if (members_[a].size() < members_[b].size())
+        std::swap(a, b);
+
+    parent_[b] = a;
+    versions_[a] = ++clock_;
+    members_[a].insert(members_[a].end(), members_[b].begin(), members_[b].end());
+    members_[b].clear();
+    members_[b].shrink_to_fit();
+}
+
+
+void FrontierComponents::reset_node(Location l) {
+    auto n = node(l);
+    parent_[n] = n;
+    registered_[n] = false;
+    members_[n].clear();
+    versions_[n] = ++clock_;
+}
+
+
+void FrontierComponents::add(Location constraint, const Location* cells, uint8_t nr) {
+    auto n = node(constraint);
+    if (registered_[n])
+        return;
+
+    registered_[n] = true;
+    cells_nr_[n] = nr;
+    members_[find(n)].push_back(constraint);
+    for(uint8_t i = 0; i < nr; ++i)
+        unite(n, node(cells[i]));
+    versions_[find(n)] = ++clock_;
+}
+
+} // namespace miner
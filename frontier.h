@@ -0,0 +1,113 @@
+#pragma once
+
+#include "cell_map.h"
+
+namespace miner {
+
+//
+// Connected components of the frontier graph: constraints (uncovered cells
+// with unknown neighbors) linked through the unknown cells they share.
+// Components are merged with union-find as constraints are registered.
+// Union-find can't split a component once cells get resolved, so a component
+// which lost constraints is rebuilt from its live ones on demand.
+//
+class FrontierComponents {
+public:
+    // Forgets everything; cells are on a board this wide.
+    void reset(size_t board_cols);
+    bool sized() const { return ids_.cols(); }
+
+    // Registers a constraint over its unknown cells; no-op if already known.
+    void add(Location constraint, const Location* cells, uint8_t nr);
+
+    bool contains(Location constraint) const {
+        auto id = ids_.find(constraint);
+        return id != CellMap<uint32_t>::kNone and registered_[id];
+    }
+
+    // Number of unknown cells a constraint had when it was registered. Once a
+    // cell gets resolved, the component might have split.
+    uint8_t cells_nr(Location constraint) const { return cells_nr_[ids_.find(constraint)]; }
+
+    // Constraints of a registered constraint's component. Includes ones that
+    // got resolved since the component was (re)built.
+    const std::vector<Location>& component(Location constraint) { return members_[root(constraint)]; }
+
+    // Same for all constraints of the component.
+    uint32_t root(Location constraint) { return find(ids_.find(constraint)); }
+
+    // Changes whenever the component gains constraints or is rebuilt, even
+    // across reset(), so that results about it can be kept meanwhile.
+    uint64_t version(Location constraint) { return versions_[root(constraint)]; }
+
+    // Rebuilds the component from its live constraints. cells_of(l, out) stores
+    // current unknown cells of constraint l into "out" and returns their
+    // number; zero means the constraint is resolved, or is to be dropped,
+    // e.g. as it's outside of a solver's window. Dropped constraints can be
+    // registered again.
+    template<class CellsOf>
+    void rebuild(Location constraint, CellsOf&& cells_of);
+
+    size_t nodes_nr() const { return parent_.size(); }
+
+private:
+    uint32_t node(Location);
+    uint32_t find(uint32_t);
+    void unite(uint32_t, uint32_t);
+    void reset_node(Location);
+
+    CellMap<uint32_t> ids_; // both constraints and cells
+    std::vector<uint32_t> parent_;
+    std::vector<bool> registered_;                // node is a registered constraint
+    std::vector<uint8_t> cells_nr_;               // see cells_nr()
+    std::vector<std::vector<Location>> members_;  // constraints, kept for roots only
+    std::vector<uint64_t> versions_;              // see version(), kept for roots only
+    uint64_t clock_{};                            // last version handed out
+};
+
+
+template<class CellsOf>
+void FrontierComponents::rebuild(Location constraint, CellsOf&& cells_of) {
+    auto old = std::move(members_[root(constraint)]);
+
+    struct Live {
+        Location constraint;
+        uint8_t nr;
+        std::array<Location, 8> cells;
+    };
+    std::vector<Live> live;
+    std::vector<Location> dropped;
+    auto r = root(constraint);
+    for(auto& c: old) {
+        Live l;
+        l.constraint = c;
+        l.nr = cells_of(c, l.cells.data());
+        if (l.nr) {
+            live.push_back(l);
+            continue;
+        }
+
+        // Cells it was registered with are among its neighbors. Those which
+        // are still unknown must not lead back into this component.
+        dropped.push_back(c);
+        for(auto row = c.row ? c.row - 1 : 0; row <= c.row + 1; ++row)
+            for(auto col = c.col ? c.col - 1 : 0; col <= c.col + 1 and col < ids_.cols(); ++col) {
+                auto id = ids_.find(Location{row, col});
+                if (id != CellMap<uint32_t>::kNone and find(id) == r)
+                    dropped.push_back(Location{row, col});
+            }
+    }
+
+    for(auto& l: dropped)
+        reset_node(l);
+    for(auto& l: live) {
+        reset_node(l.constraint);
+        for(uint8_t i = 0; i < l.nr; ++i)
+            reset_node(l.cells[i]);
+    }
+
+    for(auto& l: live)
+        add(l.constraint, l.cells.data(), l.nr);
+}
+
+} // namespace miner
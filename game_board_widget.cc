@@ -3,6 +3,15 @@
 
 namespace miner {
 
+namespace {
+
+size_t tile_bytes(const QPixmap& p) {
+    return size_t(p.width()) * p.height() * 4;
+}
+
+} // namespace
+
+
 GameBoardWidget::GameBoardWidget()
     : board_{new miner::GameBoard},
       cell_border_{200,200,200},
@@ -18,15 +27,40 @@ GameBoardWidget::GameBoardWidget()
     cell_font_.setPixelSize(kCellSize - 4);
     cell_font_.setBold(true);
     board_->set_field(std::make_shared<Field>());
+    
+    // most cores are left to the solver
+    auto workers = std::max(1u, std::min(4u, std::thread::hardware_concurrency() / 4));
+    for (size_t i = 0; i < workers; ++i)
+	workers_.emplace_back(&GameBoardWidget::render_loop, this);
+}
+
+
+GameBoardWidget::~GameBoardWidget() {
+    {
+	std::lock_guard<std::mutex> lock{render_mtx_};
+	exit_ = true;
+	render_cond_.notify_all();
+    }
+    
+    for (auto& t: workers_)
+	t.join();
 }
 
 
 void GameBoardWidget::set_board(GameBoardPtr b) {
     board_ = b;
+    reset_tiles();
     update_widget_size();
 }
 
 
+void GameBoardWidget::set_show_mines(bool v) {
+    show_mines_ = v;
+    reset_tiles();
+    update();
+}
+
+
 void GameBoardWidget::update_widget_size() {
     setFixedSize(
       board_->cols() * scaled_cell_size(),
@@ -45,44 +79,319 @@ void GameBoardWidget::set_scale_step(size_t s) {
     if (scale_step_ != s) {
         prev_scale_step_ = scale_step_;
         scale_step_ = s;
+	drop_queued(); // of the previous zoom level
         update_widget_size();
     }
 }
 
 
+// Calls f(tile_row, tile_col) for the tiles of the current zoom level which
+// "rect" intersects.
+template<class F>
+void GameBoardWidget::for_each_tile(const QRect& rect, F&& f) {
+    auto r = rect.intersected(QRect(0, 0, width(), height()));
+    if (r.isEmpty())
+	return;
+    
+    auto tile_px = tile_cache().tile_cells * scaled_cell_size();
+    for (size_t row = r.top() / tile_px; row <= r.bottom() / tile_px; ++row)
+	for (size_t col = r.left() / tile_px; col <= r.right() / tile_px; ++col)
+	    f(row, col);
+}
+
+
+// Only blits cached tiles. The changed ones are painted as they were until
+// the workers have rendered them again.
 void GameBoardWidget::paintEvent(QPaintEvent* ev) {
     QPainter painter{this};
+    auto& cache = tile_cache();
+    cache.used = ++paint_nr_;
     
-    if (is_point_mode()) {
-	for (size_t row = (size_t)std::max(0, ev->rect().top());
-             row <= (size_t)std::max(0, ev->rect().bottom()); ++row)
-	    for (size_t col = (size_t)std::max(0, ev->rect().left());
-                 col <= (size_t)std::max(0, ev->rect().right()); ++col)
-		paint_point_cell(painter, {row, col});
+    for_each_tile(ev->rect(), [&](size_t row, size_t col) {
+	auto& tile = cache.tiles[tile_key(row, col)];
+	tile.used = paint_nr_;
+	if (tile.rendered != tile.version)
+	    queue_tile(cache, tile, row, col);
 	
-    } else {
-	for (size_t row = y2row((size_t)std::max(0, ev->rect().top()));
-             row <= y2row((size_t)std::max(0, ev->rect().bottom()));
-             ++row) {
-	    for (size_t col = x2col((size_t)std::max(0, ev->rect().left()));
-                 col <= x2col((size_t)std::max(0, ev->rect().right()));
-                 ++col) {
-		paint_cell(painter, {row, col});
-            }
-        }
+	auto r = tile_rect(cache, row, col);
+	if (tile.pixmap.isNull())
+	    painter.fillRect(r, cell_unknown_bg_); // not rendered yet
+	else
+	    painter.drawPixmap(r.topLeft(), tile.pixmap);
+    });
+    
+    // and the ones around the viewport, so that panning finds them ready
+    auto tile_px = int(cache.tile_cells * scaled_cell_size());
+    for_each_tile(visibleRegion().boundingRect().adjusted(-tile_px, -tile_px, tile_px, tile_px),
+		  [&](size_t row, size_t col) {
+	auto& tile = cache.tiles[tile_key(row, col)];
+	tile.used = std::max(tile.used, paint_nr_ - 1);
+	if (tile.rendered != tile.version)
+	    queue_tile(cache, tile, row, col);
+    });
+}
+
+
+GameBoardWidget::TileCache& GameBoardWidget::tile_cache() {
+    auto& cache = tile_caches_[scale_step_];
+    if (!cache.tile_cells) {
+	cache.scale_step = scale_step_;
+	cache.tile_cells = std::max<size_t>(1, kTileSize / scaled_cell_size());
+    }
+    return cache;
+}
+
+
+QRect GameBoardWidget::tile_rect(const TileCache& cache, size_t tile_row, size_t tile_col) const {
+    auto n = cache.tile_cells, cs = cell_size(cache.scale_step);
+    auto rows = std::min(n, board_->rows() - tile_row * n);
+    auto cols = std::min(n, board_->cols() - tile_col * n);
+    return QRect(tile_col * n * cs, tile_row * n * cs, cols * cs, rows * cs);
+}
+
+
+void GameBoardWidget::queue_tile(TileCache& cache, Tile& tile, size_t tile_row, size_t tile_col) {
+    if (tile.pending)
+	return; // and queued again when done, if it changed meanwhile
+    tile.pending = true;
+    
+    TileJob job;
+    job.board = board_;
+    job.scale_step = cache.scale_step;
+    job.tile_cells = cache.tile_cells;
+    job.tile_row = tile_row;
+    job.tile_col = tile_col;
+    job.version = tile.version;
+    job.epoch = epoch_;
+    job.show_mines = show_mines_;
+    job.background = palette().color(backgroundRole());
+    
+    std::lock_guard<std::mutex> lock{render_mtx_};
+    queued_.push_back(std::move(job));
+    render_cond_.notify_one();
+}
+
+
+void GameBoardWidget::render_loop() {
+    std::unique_lock<std::mutex> lock{render_mtx_};
+    for (;;) {
+	render_cond_.wait(lock, [&] { return exit_ or !queued_.empty(); });
+	if (exit_)
+	    return;
+	
+	auto job = std::move(queued_.front());
+	queued_.pop_front();
+	lock.unlock();
+	render_tile(job);
+	lock.lock();
+	
+	rendered_.push_back(std::move(job));
+	if (rendered_.size() == 1)
+	    QMetaObject::invokeMethod(this, "take_tiles", Qt::QueuedConnection);
+    }
+}
+
+
+void GameBoardWidget::take_tiles() {
+    std::vector<TileJob> jobs;
+    {
+	std::lock_guard<std::mutex> lock{render_mtx_};
+	jobs.swap(rendered_);
+    }
+    
+    for (auto& job: jobs) {
+	if (job.epoch != epoch_)
+	    continue; // of a previous board
+	auto c = tile_caches_.find(job.scale_step);
+	if (c == tile_caches_.end())
+	    continue;
+	auto t = c->second.tiles.find(tile_key(job.tile_row, job.tile_col));
+	if (t == c->second.tiles.end())
+	    continue;
+	
+	auto& tile = t->second;
+	tile_bytes_ -= tile_bytes(tile.pixmap);
+	tile.pixmap = QPixmap::fromImage(job.image);
+	tile_bytes_ += tile_bytes(tile.pixmap);
+	tile.rendered = job.version;
+	tile.pending = false;
+	if (job.scale_step == scale_step_)
+	    update(tile_rect(c->second, job.tile_row, job.tile_col));
+    }
+    evict_tiles();
+}
+
+
+// Marks the tiles with cells of "area" changed, in every cache.
+void GameBoardWidget::invalidate(const GameBoard::Area& area) {
+    if (area.row0 >= area.row1 or area.col0 >= area.col1)
+	return;
+    
+    for (auto& c: tile_caches_) {
+	auto& tiles = c.second.tiles;
+	auto n = c.second.tile_cells;
+	auto row0 = area.row0 / n, row1 = (area.row1 - 1) / n;
+	auto col0 = area.col0 / n, col1 = (area.col1 - 1) / n;
+	if ((row1 - row0 + 1) * (col1 - col0 + 1) > tiles.size()) {
+	    for (auto& t: tiles) {
+		auto row = t.first >> 32, col = t.first & 0xffffffff;
+		if (row >= row0 and row <= row1 and col >= col0 and col <= col1)
+		    ++t.second.version;
+	    }
+	    continue;
+	}
+	
+	for (auto row = row0; row <= row1; ++row)
+	    for (auto col = col0; col <= col1; ++col) {
+		auto t = tiles.find(tile_key(row, col));
+		if (t != tiles.end())
+		    ++t->second.version;
+	    }
+    }
+    
+    // the visible tiles are queued as they are painted
+    auto cs = scaled_cell_size();
+    update(area.col0 * cs, area.row0 * cs, (area.col1 - area.col0) * cs, (area.row1 - area.row0) * cs);
+}
+
+
+void GameBoardWidget::reset_tiles() {
+    {
+	std::lock_guard<std::mutex> lock{render_mtx_};
+	queued_.clear();
+    }
+    tile_caches_.clear();
+    tile_bytes_ = 0;
+    ++epoch_;
+}
+
+
+// Drops the jobs no worker has started yet.
+void GameBoardWidget::drop_queued() {
+    std::deque<TileJob> jobs;
+    {
+	std::lock_guard<std::mutex> lock{render_mtx_};
+	jobs.swap(queued_);
+    }
+    
+    for (auto& job: jobs) {
+	auto c = tile_caches_.find(job.scale_step);
+	if (c == tile_caches_.end())
+	    continue;
+	auto t = c->second.tiles.find(tile_key(job.tile_row, job.tile_col));
+	if (t != c->second.tiles.end())
+	    t->second.pending = false;
     }
 }
 
 
-void GameBoardWidget::paint_cell(QPainter& painter, Location l) {
+// Drops the least recently painted tiles, of any zoom level, down to 3/4 of
+// kTileCacheBytes.
+void GameBoardWidget::evict_tiles() {
+    if (tile_bytes_ <= kTileCacheBytes)
+	return;
+    
+    struct Lru {
+	uint64_t used;
+	size_t scale_step;
+	uint64_t key;
+    };
+    std::vector<Lru> lru;
+    for (auto& c: tile_caches_)
+	for (auto& t: c.second.tiles)
+	    if (!t.second.pending and t.second.used < paint_nr_)
+		lru.push_back({t.second.used, c.first, t.first});
+    std::sort(lru.begin(), lru.end(), [](const Lru& a, const Lru& b) { return a.used < b.used; });
+    
+    for (auto& e: lru) {
+	if (tile_bytes_ <= kTileCacheBytes / 4 * 3)
+	    break;
+	auto& tiles = tile_caches_[e.scale_step].tiles;
+	auto t = tiles.find(e.key);
+	tile_bytes_ -= tile_bytes(t->second.pixmap);
+	tiles.erase(t);
+    }
+    
+    for (auto c = tile_caches_.begin(); c != tile_caches_.end(); )
+	if (c->second.tiles.empty())
+	    c = tile_caches_.erase(c);
+	else
+	    ++c;
+}
+
+
+// Runs on the render workers: reads the board, which the solver may be
+// changing, and the style members, which don't change after construction.
+void GameBoardWidget::render_tile(TileJob& job) const {
+    auto& board = *job.board;
+    auto n = job.tile_cells, cs = cell_size(job.scale_step);
+    GameBoard::Area area{
+	job.tile_row * n, job.tile_col * n,
+	std::min(board.rows(), (job.tile_row + 1) * n), std::min(board.cols(), (job.tile_col + 1) * n)};
+    job.image = QImage((area.col1 - area.col0) * cs, (area.row1 - area.row0) * cs, QImage::Format_RGB32);
+    
+    if (job.scale_step < kDrawTextScaleStep) {
+	render_raster(job, area);
+	return;
+    }
+    
+    // opened N0 cells are left to the background
+    job.image.fill(job.background);
+    QPainter painter{&job.image};
+    painter.translate(-double(area.col0 * cs), -double(area.row0 * cs));
+    for (auto row = area.row0; row < area.row1; ++row)
+	for (auto col = area.col0; col < area.col1; ++col)
+	    paint_cell(painter, job, {row, col});
+}
+
+
+// A pixel per cell, decoded a row at a time straight into the tile's scan
+// lines and repeated up to cell size.
+void GameBoardWidget::render_raster(TileJob& job, const GameBoard::Area& area) const {
+    auto& board = *job.board;
+    auto cs = cell_size(job.scale_step);
+    bool point_mode = job.scale_step == kPointModeScaleStep;
+    
+    // by CellInfo, from Exploded on; opened N0 cells are left to the
+    // background, as paint_cell() does, unless they are points
+    QRgb lut[12] = {
+	QColor(Qt::black).rgb(), QColor(Qt::red).rgb(), cell_unknown_bg_.rgb(),
+	point_mode ? cell_opened_bg_.rgb() : job.background.rgb()};
+    for (int n = 1; n <= 8; ++n)
+	lut[3 + n] = per_nr_colors_box_[std::min(n, 7)].rgb();
+    QRgb mine = QColor(Qt::darkRed).rgb();
+    
+    auto cols = area.col1 - area.col0;
+    std::vector<GameBoard::CellInfo> cells(cols);
+    for (auto row = area.row0; row < area.row1; ++row) {
+	board.decode_row(row, area.col0, cols, cells.data());
+	int y = (row - area.row0) * cs;
+	auto line = reinterpret_cast<QRgb*>(job.image.scanLine(y));
+	for (size_t c = 0; c < cols; ++c) {
+	    auto color = lut[static_cast<int>(cells[c]) + 3];
+	    // points show unknown mines only, cells every mine
+	    if (job.show_mines and (!point_mode or cells[c] == GameBoard::CellInfo::Unknown)
+		and board.field()->is_mined({row, area.col0 + c}))
+		color = mine;
+	    std::fill_n(line + c * cs, cs, color);
+	}
+	
+	for (size_t i = 1; i < cs; ++i)
+	    memcpy(job.image.scanLine(y + i), line, cols * cs * sizeof(QRgb));
+    }
+}
+
+
+void GameBoardWidget::paint_cell(QPainter& painter, const TileJob& job, Location l) const {
     painter.save();
     
-    painter.translate(col2x(l.col), row2y(l.row));
-    auto scale_factor = get_scale_factor();
+    auto cs = cell_size(job.scale_step);
+    painter.translate(double(l.col * cs), double(l.row * cs));
+    auto scale_factor = job.scale_step * kScaleStep;
     painter.scale(scale_factor, scale_factor);
     
     QRect r;
-    if (scale_step_ >= kDrawBorderScaleStep) {
+    if (job.scale_step >= kDrawBorderScaleStep) {
         // draw border
 	painter.setPen(cell_border_);
 	painter.drawLine(0, 0, kCellSize - 1, 0);
@@ -94,10 +403,9 @@ void GameBoardWidget::paint_cell(QPainter& painter, Location l) {
 	r = {0, 0, kCellSize, kCellSize};
     }
     
-    if (scale_step_ >= kDrawTextScaleStep)
-	painter.setFont(cell_font_);
+    painter.setFont(cell_font_);
     
-    auto ci = board_->at(l);
+    auto ci = job.board->at(l);
     switch(ci) {
     case GameBoard::CellInfo::Exploded:
 	painter.fillRect(r, QBrush(Qt::black));
@@ -122,81 +430,29 @@ void GameBoardWidget::paint_cell(QPainter& painter, Location l) {
     case GameBoard::CellInfo::N6:
     case GameBoard::CellInfo::N7:
     case GameBoard::CellInfo::N8:
-	if (scale_step_ >= kDrawTextScaleStep) {
-	    painter.fillRect(r, cell_opened_bg_);
-	    painter.setPen(per_nr_colors_text_[static_cast<int>(ci)]);
-	    painter.drawText(1, kCellSize - 1, QString::number(static_cast<int>(ci)));
-	    
-	} else {
-	    painter.fillRect(r, per_nr_colors_box_[static_cast<int>(ci)]);
-	}
+	painter.fillRect(r, cell_opened_bg_);
+	painter.setPen(per_nr_colors_text_[static_cast<int>(ci)]);
+	painter.drawText(1, kCellSize - 1, QString::number(static_cast<int>(ci)));
 	break;
     };
     
-    if (show_mines_ and board_->field()->is_mined(l)) {
-	if (scale_step_ >= kDrawTextScaleStep) {
-	    painter.setPen(Qt::red);
-	    for (size_t r = 1; r < 8; ++r)
-		for (size_t c = kCellSize - 8 + r; c < kCellSize; ++c)
-		    painter.drawPoint(c, r);
-	} else {
-	    painter.fillRect(r, Qt::darkRed);
-	}
+    if (job.show_mines and job.board->field()->is_mined(l)) {
+	painter.setPen(Qt::red);
+	for (size_t r = 1; r < 8; ++r)
+	    for (size_t c = kCellSize - 8 + r; c < kCellSize; ++c)
+		painter.drawPoint(c, r);
     }
     
     painter.restore();
 }
 
 
-void GameBoardWidget::paint_point_cell(QPainter& painter, Location l) {
-    auto ci = board_->at(l);
-    switch(ci) {
-    case GameBoard::CellInfo::Exploded:
-	painter.setPen(Qt::black);
-	break;
-	
-    case GameBoard::CellInfo::MarkedMine:
-	painter.setPen(Qt::red);
-	break;
-	
-    case GameBoard::CellInfo::Unknown:
-	if (show_mines_ and board_->field()->is_mined(l))
-	    painter.setPen(Qt::darkRed);
-	else
-	    painter.setPen(cell_unknown_bg_);
-	break;
-	
-    case GameBoard::CellInfo::N0:
-	painter.setPen(cell_opened_bg_);
-	break;
-	
-    case GameBoard::CellInfo::N1:
-    case GameBoard::CellInfo::N2:
-    case GameBoard::CellInfo::N3:
-    case GameBoard::CellInfo::N4:
-    case GameBoard::CellInfo::N5:
-    case GameBoard::CellInfo::N6:
-    case GameBoard::CellInfo::N7:
-    case GameBoard::CellInfo::N8:
-	painter.setPen(per_nr_colors_box_[static_cast<int>(ci)]);
-	break;
-    };
-    
-    painter.drawPoint(l.col, l.row);
-}
-
-
 void GameBoardWidget::mouseReleaseEvent(QMouseEvent* ev) {
     if (!rw_  or board_->game_lost())
 	return;
     
-    Location l;
-    if (is_point_mode())
-	l = {(size_t)std::max(0, ev->y()),
-             (size_t)std::max(0, ev->x())};
-    else
-	l = {y2row((size_t)std::max(0, ev->y())),
-             x2col((size_t)std::max(0, ev->x()))};
+    Location l{y2row((size_t)std::max(0, ev->y())),
+               x2col((size_t)std::max(0, ev->x()))};
     
     switch(ev->button()) {
     case Qt::LeftButton: {
@@ -247,32 +503,16 @@ void GameBoardWidget::mouseReleaseEvent(QMouseEvent* ev) {
 
 
 void GameBoardWidget::update_cell(Location l) {
-    if (is_point_mode()) {
-	update(l.col, l.row, 1, 1);
-        
-    } else {
-	update(
-          col2x(l.col), row2y(l.row),
-          scaled_cell_size(), scaled_cell_size());
-    }
+    invalidate({l.row, l.col, l.row + size_t(1), l.col + size_t(1)});
 }
 
 
 void GameBoardWidget::update_box(Location center, size_t range) {
-    if (is_point_mode()) {
-	update(
-          i::subtract_floor_0(center.col, range),
-          i::subtract_floor_0(center.row, range),
-          1 + range * 2,
-          1 + range * 2);
-	
-    } else {
-	update(
-          col2x(i::subtract_floor_0(center.col, range)),
-          row2y(i::subtract_floor_0(center.row, range)),
-          (1 + range * 2) * scaled_cell_size(),
-          (1 + range * 2) * scaled_cell_size());
-    }
+    invalidate({
+      i::subtract_floor_0(center.row, range),
+      i::subtract_floor_0(center.col, range),
+      std::min(board_->rows(), center.row + range + 1),
+      std::min(board_->cols(), center.col + range + 1)});
 }
 
 
@@ -305,8 +545,9 @@ void GameBoardWidget::switch_point_mode(bool v) {
 }
 
 
-size_t GameBoardWidget::scaled_cell_size() const {
-    return is_point_mode() ? 1 : get_scale_factor() * kCellSize;
+// Whole pixels, so that cells and tiles line up at every zoom level.
+size_t GameBoardWidget::cell_size(size_t scale_step) {
+    return std::max<size_t>(1, scale_step * kScaleStep * kCellSize + 0.5f);
 }
 
 } // namespace miner
@@ -1,12 +1,9 @@
 #pragma once
 
-#include "field.h"
+#include "board.h"
 
 namespace miner {
 
-class GameBoard;
-using GameBoardPtr = std::shared_ptr<GameBoard>;
-
 class GameBoardWidget : public QWidget {
     Q_OBJECT;
 public:
@@ -20,11 +17,17 @@ public:
     static constexpr size_t kMinScaleStep = 1;
     static constexpr size_t kMaxScaleStep = kMaxScale / kScaleStep;
     
+    // The board is painted from a cache of tiles per zoom level, rendered
+    // off the GUI thread. Tiles are up to kTileSize pixels square, or a cell.
+    static constexpr size_t kTileSize = 256;
+    static constexpr size_t kTileCacheBytes = size_t(256) << 20;
+    
     GameBoardWidget();
+    ~GameBoardWidget();
     
     GameBoardPtr board() { return board_; }
     void set_board(GameBoardPtr);
-    void set_show_mines(bool v) { show_mines_ = v; update(); }
+    void set_show_mines(bool);
     void update_cell(Location);
     void update_box(Location center, size_t range);
     void set_scale_step(size_t step);
@@ -40,6 +43,9 @@ signals:
     void cell_changed(miner::Location);
     void game_lost();
     
+private slots:
+    void take_tiles(); // rendered by the workers
+    
 protected:
     void paintEvent(QPaintEvent*) override;
     void mouseReleaseEvent(QMouseEvent*) override;
@@ -47,20 +53,72 @@ protected:
     bool is_point_mode() const { return scale_step_ == kPointModeScaleStep; }
     
 private:
-    void paint_cell(QPainter&, Location);
-    void paint_point_cell(QPainter&, Location);
-    size_t x2col(size_t x) { return is_point_mode() ? 1 : x / get_scale_factor() / kCellSize; }
-    size_t y2row(size_t y) { return is_point_mode() ? 1 : y / get_scale_factor() / kCellSize; }
-    size_t row2y(size_t row) { return is_point_mode() ? 1 : get_scale_factor() * row * kCellSize; }
-    size_t col2x(size_t col) { return is_point_mode() ? 1 : get_scale_factor() * col * kCellSize; }
-    float get_scale_factor() const { return scale_step_ * kScaleStep; }
-    size_t scaled_cell_size() const;
+    struct Tile {
+	QPixmap pixmap;      // null until first rendered
+	uint64_t version{1}; // bumped when its cells change
+	uint64_t rendered{}; // version in pixmap
+	uint64_t used{};     // paint_nr_ when last painted
+	bool pending{};      // queued or being rendered
+    };
+    
+    struct TileCache {
+	size_t scale_step{};
+	size_t tile_cells{}; // per side
+	std::unordered_map<uint64_t, Tile> tiles; // by tile_key()
+	uint64_t used{};
+    };
+    
+    // Everything a worker needs to render a tile, copied on the GUI thread
+    struct TileJob {
+	GameBoardPtr board;
+	size_t scale_step{}, tile_cells{};
+	size_t tile_row{}, tile_col{};
+	uint64_t version{}, epoch{};
+	bool show_mines{};
+	QColor background;
+	QImage image;
+    };
+    
+    static uint64_t tile_key(size_t tile_row, size_t tile_col) { return uint64_t(tile_row) << 32 | tile_col; }
+    static size_t cell_size(size_t scale_step);
+    
+    TileCache& tile_cache(); // of the current zoom level
+    template<class F> void for_each_tile(const QRect&, F&&);
+    QRect tile_rect(const TileCache&, size_t tile_row, size_t tile_col) const;
+    void queue_tile(TileCache&, Tile&, size_t tile_row, size_t tile_col);
+    void invalidate(const GameBoard::Area&);
+    void reset_tiles(); // after the board or the way it's shown changed
+    void drop_queued();
+    void evict_tiles();
+    void render_tile(TileJob&) const;
+    // for cells too small for text: a lookup per cell instead of painting it
+    void render_raster(TileJob&, const GameBoard::Area&) const;
+    void paint_cell(QPainter&, const TileJob&, Location) const;
+    void render_loop();
+    
+    size_t x2col(size_t x) { return x / scaled_cell_size(); }
+    size_t y2row(size_t y) { return y / scaled_cell_size(); }
+    size_t scaled_cell_size() const { return cell_size(scale_step_); }
     void update_widget_size();
     
     GameBoardPtr board_;
     bool show_mines_{};
     bool rw_{};
     
+    // tiles, used on the GUI thread only
+    std::unordered_map<size_t, TileCache> tile_caches_; // by scale step
+    size_t tile_bytes_{};
+    uint64_t paint_nr_{};
+    uint64_t epoch_{}; // of the board and show_mines_, stale jobs are dropped
+    
+    // render workers
+    std::vector<std::thread> workers_;
+    std::mutex render_mtx_;        // protects the members below
+    std::condition_variable render_cond_;
+    std::deque<TileJob> queued_;
+    std::vector<TileJob> rendered_;
+    bool exit_{};
+    
     QColor cell_border_;
     QColor cell_opened_bg_;
     QColor cell_unknown_bg_;
@@ -54,6 +54,49 @@ void problem::set_matrix(const matrix& m) {
       m.get_rows().data(),
       m.get_columns().data(),
       m.get_values().data());
+    changes_ |= kModelChanged;
+}
+
+
+namespace {
+
+// glpk takes 1-based arrays
+matrix::dimension_vector_type one_based(const matrix::dimension_vector_type& v) {
+    matrix::dimension_vector_type rv{0};
+    rv.insert(rv.end(), v.begin(), v.end());
+    return rv;
+}
+
+} // namespace
+
+
+void problem::set_row_coefficients(
+  int row, const matrix::dimension_vector_type& cols,
+  const matrix::value_vector_type& values) {
+    
+    auto ind = one_based(cols);
+    matrix::value_vector_type val{0};
+    val.insert(val.end(), values.begin(), values.end());
+    glp_set_mat_row(glp_, row, cols.size(), ind.data(), val.data());
+    changes_ |= kModelChanged;
+}
+
+
+void problem::del_rows(const matrix::dimension_vector_type& rows) {
+    if (rows.empty())
+	return;
+    auto num = one_based(rows);
+    glp_del_rows(glp_, rows.size(), num.data());
+    changes_ |= kModelChanged;
+}
+
+
+void problem::del_columns(const matrix::dimension_vector_type& cols) {
+    if (cols.empty())
+	return;
+    auto num = one_based(cols);
+    glp_del_cols(glp_, cols.size(), num.data());
+    changes_ |= kModelChanged;
 }
 
 
@@ -31,6 +31,14 @@ public:
 	kUndefined = GLP_UNDEF,
     };
     
+    // counters of simplex runs, see set_probing()
+    struct simplex_stats {
+	size_t solves{};
+	size_t dual_solves{};  // warm-started with dual simplex after bound changes
+	size_t basis_resets{}; // kept basis was unusable, started from scratch
+	size_t iterations{};
+    };
+    
     problem();
     problem(const problem&) = delete;
     problem& operator=(const problem&) = delete;
@@ -42,46 +50,63 @@ public:
     
     // objective
     void set_objective_name(const char* n) { glp_set_obj_name(glp_, n); }
-    void set_maximize() { glp_set_obj_dir(glp_, GLP_MAX); }
-    void set_minimize() { glp_set_obj_dir(glp_, GLP_MIN); }
+    void set_maximize() { glp_set_obj_dir(glp_, GLP_MAX); changes_ |= kModelChanged; }
+    void set_minimize() { glp_set_obj_dir(glp_, GLP_MIN); changes_ |= kModelChanged; }
     
     // structural (column) variables
-    int add_column_variables(int nr) { return glp_add_cols(glp_, nr); }
+    int add_column_variables(int nr) { changes_ |= kModelChanged; return glp_add_cols(glp_, nr); }
     void set_column_name(int c, const char* name) { glp_set_col_name(glp_, c, name); }
     void set_column_upper_bounded(int col, double bound) {
         glp_set_col_bnds(glp_, col, GLP_UP, 0, bound);
+        changes_ |= kBoundsChanged;
     }
     void set_column_lower_bounded(int col, double bound) {
         glp_set_col_bnds(glp_, col, GLP_LO, bound, 0);
+        changes_ |= kBoundsChanged;
     }
     void set_column_bounded(int col, double lb, double ub) {
         glp_set_col_bnds(glp_, col, GLP_DB, lb, ub);
+        changes_ |= kBoundsChanged;
     }
     void set_column_fixed_bound(int col, double bound) {
         glp_set_col_bnds(glp_, col, GLP_FX, bound, bound);
+        changes_ |= kBoundsChanged;
+    }
+    void set_column_unbounded(int col) {
+        glp_set_col_bnds(glp_, col, GLP_FR, 0, 0);
+        changes_ |= kBoundsChanged;
+    }
+    void set_objective_coefficient(int col, double v) {
+        glp_set_obj_coef(glp_, col, v);
+        changes_ |= kModelChanged;
     }
-    void set_column_unbounded(int col) { glp_set_col_bnds(glp_, col, GLP_FR, 0, 0); }
-    void set_objective_coefficient(int col, double v) { glp_set_obj_coef(glp_, col, v); }
     double get_column_primal(int col) { return glp_get_col_prim(glp_, col); }
     double get_column_dual(int col) { return glp_get_col_dual(glp_, col); }
     int get_num_columns() { return glp_get_num_cols(glp_); }
     
     // aux (row) variables
-    int add_row_variables(int nr) { return glp_add_rows(glp_, nr); }
+    int add_row_variables(int nr) { changes_ |= kModelChanged; return glp_add_rows(glp_, nr); }
     void set_row_name(int row, const char* name) { glp_set_row_name(glp_, row, name); }
     void set_row_upper_bounded(int row, double bound) {
         glp_set_row_bnds(glp_, row, GLP_UP, 0, bound);
+        changes_ |= kBoundsChanged;
     }
     void set_row_lower_bounded(int row, double bound) {
         glp_set_row_bnds(glp_, row, GLP_LO, bound, 0);
+        changes_ |= kBoundsChanged;
     }
     void set_row_bounded(int row, double lb, double ub) {
         glp_set_row_bnds(glp_, row, GLP_DB, lb, ub);
+        changes_ |= kBoundsChanged;
     }
     void set_row_fixed_bound(int row, double bound) {
         glp_set_row_bnds(glp_, row, GLP_FX, bound, bound);
+        changes_ |= kBoundsChanged;
+    }
+    void set_row_unbounded(int row) {
+        glp_set_row_bnds(glp_, row, GLP_FR, 0, 0);
+        changes_ |= kBoundsChanged;
     }
-    void set_row_unbounded(int row) { glp_set_row_bnds(glp_, row, GLP_FR, 0, 0); }
     double get_row_primal(int row) { return glp_get_row_prim(glp_, row); }
     double get_row_dual(int row) { return glp_get_row_dual(glp_, row); }
     int get_num_rows() { return glp_get_num_rows(glp_); }
@@ -89,6 +114,13 @@ public:
     void set_matrix(const matrix&);
     double get_objective_value() { return glp_get_obj_val(glp_); }
     
+    // incremental model changes; deleting renumbers rows/columns which follow
+    void set_row_coefficients(
+      int row, const matrix::dimension_vector_type& cols,
+      const matrix::value_vector_type& values);
+    void del_rows(const matrix::dimension_vector_type& rows);
+    void del_columns(const matrix::dimension_vector_type& cols);
+    
     bool solve();
     bool presolve();
     static const char* errmsg(int ec) { return kErrorMessages[ec]; }
@@ -100,10 +132,26 @@ public:
     std::string dump();
     void set_verbose(int v) { glp_opt_.msg_lev = v; }
     
+    // In probing mode solve() starts from the basis of the previous solve and
+    // picks the method which keeps it feasible: dual simplex if only bounds
+    // changed since then, primal otherwise (e.g. after objective changes).
+    void set_probing(bool v) { probing_ = v; }
+    const simplex_stats& stats() const { return stats_; }
+    int last_iterations() const { return last_iterations_; }
+    
 private:
+    enum : uint8_t {
+	kBoundsChanged = 1,
+	kModelChanged = 2,
+    };
+    
     glp_prob* glp_{};
     glp_smcp glp_opt_;
     int last_ec_{}; // error code for the last call to the solver
+    bool probing_{};
+    uint8_t changes_{}; // since the last solve
+    int last_iterations_{};
+    simplex_stats stats_;
 };
 
 } // namespace lp
@@ -8,7 +8,24 @@ inline void matrix::add(int row, int col, double value) {
 
 
 inline bool problem::solve() {
+    auto dual = probing_ and changes_ == kBoundsChanged;
+    glp_opt_.meth = dual ? GLP_DUALP : GLP_PRIMAL;
+    auto it_cnt = glp_get_it_cnt(glp_);
+    
     last_ec_ = glp_simplex(glp_, &glp_opt_);
+    if (last_ec_ == GLP_EBADB or last_ec_ == GLP_ESING or last_ec_ == GLP_ECOND) {
+	// incremental changes may leave previous basis unusable
+	glp_std_basis(glp_);
+	glp_opt_.meth = GLP_PRIMAL;
+	last_ec_ = glp_simplex(glp_, &glp_opt_);
+	++stats_.basis_resets;
+    }
+    
+    changes_ = 0;
+    last_iterations_ = glp_get_it_cnt(glp_) - it_cnt;
+    ++stats_.solves;
+    stats_.dual_solves += dual;
+    stats_.iterations += last_iterations_;
     //I_ASSERT(!last_ec_, EX_LOG("ERROR: " << lp::problem::errmsg(last_ec_)));
     return get_status() == status::kOPT;
 }
@@ -0,0 +1,164 @@
+#include "glpk_lp_problem.h"
+#include "glpk_region_model.h"
+
+namespace miner {
+
+namespace {
+
+bool same(const Solver::NeighborhoodInfo& a, const Solver::NeighborhoodInfo& b) {
+    return a.mines_nr == b.mines_nr and a.nr == b.nr
+	and std::equal(a.coveredUnmarkedLocations.begin(),
+		       a.coveredUnmarkedLocations.begin() + a.nr,
+		       b.coveredUnmarkedLocations.begin());
+}
+
+} // namespace
+
+
+GlpkRegionModel::GlpkRegionModel(size_t board_cols) : lp_{new lp::problem} {
+    // the model is probed over and over with small changes in between
+    lp_->set_probing(true);
+    rows_.clear(board_cols);
+    cols_.clear(board_cols);
+    wanted_.clear(board_cols);
+    used_.clear(board_cols);
+}
+
+
+GlpkRegionModel::~GlpkRegionModel() {
+}
+
+
+int GlpkRegionModel::column(Location l) {
+    auto c = cols_.find(l);
+    if (c == VariablesMapType::kNone) {
+	c = lp_->add_column_variables(1);
+	cols_.emplace(l, c);
+	col_keys_.push_back(l);
+
+	std::ostringstream oss;
+	oss << 'u' << l;
+	lp_->set_column_name(c, oss.str().data());
+	lp_->set_column_bounded(c, 0, 1);
+    }
+
+    return c;
+}
+
+
+void GlpkRegionModel::set_row(int row, const Solver::NeighborhoodInfo& info) {
+    lp::matrix::dimension_vector_type cols;
+    for(uint8_t i = 0; i < info.nr; ++i)
+	cols.push_back(column(info.coveredUnmarkedLocations[i]));
+
+    lp_->set_row_coefficients(row, cols, lp::matrix::value_vector_type(cols.size(), 1));
+    lp_->set_row_fixed_bound(row, info.mines_nr);
+}
+
+
+void GlpkRegionModel::sync(
+  const std::vector<Location>& constraints,
+  const std::vector<Solver::NeighborhoodInfo>& infos,
+  std::vector<Location>& removed, SyncStats& stats) {
+
+    wanted_.clear();
+    for(size_t i = 0; i < constraints.size(); ++i)
+	if (infos[i].nr)
+	    wanted_.emplace(constraints[i], i);
+
+    //
+    // delete rows of constraints which left the region or got resolved
+    //
+    lp::matrix::dimension_vector_type del;
+    for(size_t r = 0; r < row_keys_.size(); ++r)
+	if (!wanted_.count(row_keys_[r]))
+	    del.push_back(r + 1);
+
+    if (!del.empty()) {
+	lp_->del_rows(del);
+	stats.rows_removed += del.size();
+
+	size_t k{};
+	rows_.clear();
+	for(size_t r = 0, d = 0; r < row_keys_.size(); ++r) {
+	    if (d < del.size() and del[d] == int(r + 1)) {
+		++d;
+		removed.push_back(row_keys_[r]);
+		continue;
+	    }
+
+	    row_keys_[k] = row_keys_[r];
+	    row_infos_[k] = row_infos_[r];
+	    rows_.emplace(row_keys_[k], k + 1);
+	    ++k;
+	}
+	row_keys_.resize(k);
+	row_infos_.resize(k);
+    }
+
+    //
+    // update changed rows, add new ones
+    //
+    auto cols_nr = col_keys_.size();
+    for(size_t i = 0; i < constraints.size(); ++i) {
+	auto& info = infos[i];
+	if (!info.nr)
+	    continue;
+
+	auto existing = rows_.find(constraints[i]);
+	if (existing != CellMap<uint32_t>::kNone) {
+	    if (!same(row_infos_[existing - 1], info)) {
+		set_row(existing, info);
+		row_infos_[existing - 1] = info;
+		++stats.rows_updated;
+	    }
+	    continue;
+	}
+
+	auto row = lp_->add_row_variables(1);
+	std::ostringstream oss;
+	oss << 'n' << constraints[i];
+	lp_->set_row_name(row, oss.str().data());
+	set_row(row, info);
+
+	rows_.emplace(constraints[i], row);
+	row_keys_.push_back(constraints[i]);
+	row_infos_.push_back(info);
+	++stats.rows_added;
+    }
+    stats.columns_added += col_keys_.size() - cols_nr;
+
+    //
+    // delete columns of cells no row refers to
+    //
+    used_.clear();
+    for(auto& info: row_infos_)
+	for(uint8_t i = 0; i < info.nr; ++i)
+	    used_.emplace(info.coveredUnmarkedLocations[i], 1);
+
+    del.clear();
+    for(size_t c = 0; c < col_keys_.size(); ++c)
+	if (!used_.count(col_keys_[c]))
+	    del.push_back(c + 1);
+
+    if (!del.empty()) {
+	lp_->del_columns(del);
+	stats.columns_removed += del.size();
+
+	size_t k{};
+	cols_.clear();
+	for(size_t c = 0, d = 0; c < col_keys_.size(); ++c) {
+	    if (d < del.size() and del[d] == int(c + 1)) {
+		++d;
+		continue;
+	    }
+
+	    col_keys_[k] = col_keys_[c];
+	    cols_.emplace(col_keys_[k], k + 1);
+	    ++k;
+	}
+	col_keys_.resize(k);
+    }
+}
+
+} // namespace miner
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "cell_map.h"
+#include "solver.h"
+
+namespace lp { class problem; }
+
+namespace miner {
+
+//
+// Long-lived LP model of a frontier region: one row per constraint, one
+// column per unknown cell. sync() turns it into the model of a new set of
+// constraints by adding, updating and deleting only the rows and columns
+// which changed, so that GLPK keeps its data structures and basis between
+// solves of almost the same region.
+//
+class GlpkRegionModel {
+public:
+    // maps location to variable id in an LP
+    using VariablesMapType = CellMap<uint32_t>;
+
+    struct SyncStats {
+        size_t rows_added{};
+        size_t rows_updated{};
+        size_t rows_removed{};
+        size_t columns_added{};
+        size_t columns_removed{};
+    };
+
+    explicit GlpkRegionModel(size_t board_cols);
+    ~GlpkRegionModel();
+
+    // Makes the model hold exactly the given constraints, described by their
+    // current neighborhoods. Constraints which were dropped are appended to
+    // "removed".
+    void sync(const std::vector<Location>& constraints,
+              const std::vector<Solver::NeighborhoodInfo>& infos,
+              std::vector<Location>& removed, SyncStats&);
+
+    lp::problem& lp() { return *lp_; }
+    const VariablesMapType& vars() const { return cols_; }
+    const std::vector<Location>& constraints() const { return row_keys_; }
+
+private:
+    int column(Location);
+    void set_row(int row, const Solver::NeighborhoodInfo&);
+
+    std::unique_ptr<lp::problem> lp_;
+    std::vector<Location> row_keys_;                  // constraint of LP row i + 1
+    std::vector<Solver::NeighborhoodInfo> row_infos_; // as loaded into LP
+    CellMap<uint32_t> rows_;                          // constraint -> LP row
+    std::vector<Location> col_keys_;                  // cell of LP column i + 1
+    VariablesMapType cols_;                           // cell -> LP column
+    CellMap<uint32_t> wanted_;                        // sync()'s constraint -> index
+    CellMap<uint8_t> used_;                           // cells some row refers to
+};
+
+} // namespace miner
@@ -3,13 +3,14 @@
 
 namespace miner {
 
-struct lp_row_info {
-    lp_row_info(uint8_t v, std::string n)
-        : fixed_value{v}, name{n} {}
-    
-    uint8_t fixed_value;
-    std::string name;
-};
+GlpkSolver::GlpkSolver(GameBoardPtr board)
+    : Solver{board} {
+    owner_.clear(board_->cols());
+}
+
+
+GlpkSolver::~GlpkSolver() {
+}
 
 
 bool GlpkSolver::doPoi(miner::Location poi) {
@@ -19,139 +20,305 @@ bool GlpkSolver::doPoi(miner::Location poi) {
 	    return true;
     }
     
-    auto lp = std::make_unique<lp::problem>();
+    // common patterns don't need an LP
+    if (!reduce(poi))
+	return false;
+    
+    if (board_->is_uncovered(poi)) {
+	auto pois = getNeighborhoodInfo(poi);
+	if (!pois.nr)
+	    return true;
+    }
+    
+    // one LP per frontier component
+    collectComponents(poi, components_);
+    for(auto& constraints: components_)
+	if (!solveComponent(poi, constraints))
+	    return false;
+    
+    // near the end, the number of mines left may resolve what components can't
+    if (!solveGlobal(poi))
+	return false;
+    
+    return true;
+}
+
+
+uint32_t GlpkSolver::regionFor(const std::vector<Location>& constraints) {
+    // region owning most of the constraints needs the fewest changes; there
+    // are only a few candidates, so a linear search finds their votes
+    votes_.clear();
+    auto rv = kNoRegion;
+    size_t best{};
+    for(auto& c: constraints) {
+	auto r = owner_.find(c);
+	if (r == CellMap<uint32_t>::kNone or r == kNoRegion)
+	    continue;
+	
+	auto it = std::find_if(votes_.begin(), votes_.end(),
+	                       [r](const std::pair<uint32_t, size_t>& v) { return v.first == r; });
+	if (it == votes_.end())
+	    it = votes_.emplace(votes_.end(), r, 0);
+	if (++it->second > best) {
+	    best = it->second;
+	    rv = r;
+	}
+    }
+    
+    if (rv == kNoRegion) {
+	rv = uint32_t(regions_.size());
+	regions_.emplace_back(new Region{board_->cols()});
+	++stats_.models_created;
+    }
+    
+    return rv;
+}
+
+
+void GlpkSolver::updateOwners(uint32_t region, const std::vector<Location>& removed) {
+    auto& owned = regions_[region]->owned;
+    for(auto& c: removed)
+	if (owner_.find(c) == region) {
+	    owner_.assign(c, kNoRegion);
+	    --owned;
+	}
+    
+    for(auto& c: regions_[region]->model.constraints()) {
+	auto o = owner_.find(c);
+	if (o == region)
+	    continue;
+	
+	if (o != CellMap<uint32_t>::kNone and o != kNoRegion)
+	    --regions_[o]->owned;
+	owner_.assign(c, region);
+	++owned;
+    }
+}
+
+
+void GlpkSolver::deleteAbandoned() {
+    renumbered_.clear();
+    uint32_t kept{};
+    for(auto& r: regions_)
+	renumbered_.push_back(r->owned ? kept++ : kNoRegion);
+    
+    auto end = std::remove_if(regions_.begin(), regions_.end(),
+                              [](const std::unique_ptr<Region>& r) { return !r->owned; });
+    stats_.models_deleted += regions_.end() - end;
+    regions_.erase(end, regions_.end());
+    
+    // also drops constraints given up, which owner_ otherwise keeps as keys
+    owners_.clear(board_->cols());
+    for(auto i: owner_.keys()) {
+	auto r = owner_.find(i);
+	if (r != kNoRegion)
+	    owners_.emplace(owner_.location(i), renumbered_[r]);
+    }
+    std::swap(owner_, owners_);
+}
+
+
+void GlpkSolver::windowChanged() {
+    // Models may keep constraints outside of the new window until their next
+    // sync() drops them, but collectRegions() mustn't look at those.
+    for(auto i: owner_.keys()) {
+	auto r = owner_.find(i);
+	auto c = owner_.location(i);
+	if (r == kNoRegion or inWindow(c))
+	    continue;
+	
+	--regions_[r]->owned;
+	owner_.assign(c, kNoRegion);
+    }
+    
+    deleteAbandoned();
+}
+
+
+void GlpkSolver::collectRegions() {
+    // forget constraints which got resolved while their region wasn't looked at
+    for(auto i: owner_.keys()) {
+	auto r = owner_.find(i);
+	auto c = owner_.location(i);
+	if (r == kNoRegion or getNeighborhoodInfo(c).nr)
+	    continue;
+	
+	--regions_[r]->owned;
+	owner_.assign(c, kNoRegion);
+    }
+    
+    deleteAbandoned();
+}
+
+
+bool GlpkSolver::solveComponent(Location poi, const std::vector<Location>& constraints) {
+    if (++solves_nr_ % kCollectInterval == 0)
+	collectRegions();
+    
+    infos_.clear();
+    for(auto& l: constraints)
+	infos_.push_back(board_->is_uncovered(l) ? getNeighborhoodInfo(l) : NeighborhoodInfo{});
+    
+    // turn the closest existing model into this component's one
+    auto region = regionFor(constraints);
+    auto& model = regions_[region]->model;
+    removed_.clear();
+    model.sync(constraints, infos_, removed_, stats_.sync);
+    updateOwners(region, removed_);
     
     // a set of locations LP is looking at; maps coord to LP's column variable number
-    VariablesMapType vars;
-    prepare(lp.get(), poi, vars);
+    auto& vars = model.vars();
     if (vars.empty())
 	return true;
     
-    for(auto& v: vars) {
-	lp->set_objective_coefficient(v.second, 1);
-	lp->set_maximize();
-	lp->solve();
+    return probe(poi, &model.lp(), vars);
+}
+
+
+bool GlpkSolver::probe(Location poi, lp::problem* lp, const VariablesMapType& vars) {
+    // Every solution is a witness: a column seen at 0 can't be a mine, one
+    // seen at 1 can't be safe, so probing for those is pointless. Fractional
+    // values prove nothing, as LP bounds below 1 still make a cell safe.
+    witnesses_.assign(lp->get_num_columns() + 1, 0);
+    auto solve = [&] {
+	auto rv = lp->solve();
+	++stats_.lp_solves;
+	stats_.simplex_iterations += lp->last_iterations();
+	if (rv)
+	    for(int c = 1; c < int(witnesses_.size()); ++c) {
+		auto x = lp->get_column_primal(c);
+		witnesses_[c] |= (x < kEpsilon ? kSeenSafe : 0) | (x > 1 - kEpsilon ? kSeenMined : 0);
+	    }
+	return rv;
+    };
+    
+    if (!solve()) {
+	errlog << "ERROR: could not solve: " << lp->last_errmsg()
+	       << "\npoi=" << poi
+	       << "\nLP: " << lp->dump() << "\n";
+	board_->dump_region(poi, kRange);
+	exit(-1);
+    }
+    
+    for(auto i: vars.keys()) {
+	auto l = vars.location(i);
+	int col = vars.find(i);
+	auto& seen = witnesses_[col];
+	if (seen == (kSeenSafe | kSeenMined)) {
+	    stats_.probes_skipped += 2;
+	    continue;
+	}
+	
+	lp->set_objective_coefficient(col, 1);
+	auto obj = 1.;
+	if (seen & kSeenMined) {
+	    ++stats_.probes_skipped;
+	} else {
+	    lp->set_maximize();
+	    solve();
+	    obj = lp->get_objective_value();
+	}
 	
-	auto obj = lp->get_objective_value();
 	if (obj <= 1 - kEpsilon) {
 	    // can't have a mine here
-	    if (board_->field()->is_mined(v.first)) {
-		xlog << "ERROR: game is lost at " << v.first << ": shold've been empty, has a mine"
-		     << "\nobj=" << obj
-		     << "\npoi=" << poi
-		     << "\nLP: " << lp->dump() << "\n";
-		board_->dump_region(poi, 3);
-		resultHandler_(FeedbackState::kGameLost, Location{}, 0);
+	    if (!applyDeduction(poi, l, false))
 		return false;
-	    }
 	    
-	    board_->uncovered_safe(v.first, board_->field()->nearby_mines_nr(v.first));
-	    lp->set_column_fixed_bound(v.second, 0);
-            addPoi(v.first);
+	    lp->set_column_fixed_bound(col, 0);
+	    solve(); // dual simplex gets the basis back to optimal in a few pivots
             
+	} else if (seen & kSeenSafe) {
+	    ++stats_.probes_skipped;
+	    
 	} else {
 	    lp->set_minimize();
-	    lp->solve();
+	    solve();
 	    auto obj = lp->get_objective_value();
 	    if (obj >= kEpsilon) { // must have a mine here
-		if (!board_->field()->is_mined(v.first)) {
-		    xlog << "ERROR: calculated " << v.first << " to contain a mine, but it doesn't"
-			 << "\nobj=" << obj
-			 << "\npoi=" << poi
-			 << "\nLP: " << lp->dump() << "\n";
-		    board_->dump_region(poi, 3);
+		if (!applyDeduction(poi, l, true))
 		    return false;
-		}
 		
-		board_->mark_mine(v.first, true);
-		lp->set_column_fixed_bound(v.second, 1);
-                addPoi(v.first);
+		lp->set_column_fixed_bound(col, 1);
+		solve();
 	    }
 	}
 	
-	lp->set_objective_coefficient(v.second, 0);
+	lp->set_objective_coefficient(col, 0);
     }
     
     return true;
 }
 
-
-void GlpkSolver::prepare(lp::problem* lp, Location poi, VariablesMapType& vars) {
-    std::ostringstream oss;
-    
-    int vars_nr{};
-    
+bool GlpkSolver::probeGlobal(Location poi, GlobalModel& gm) {
     //
-    // setup initial LP
+    // every frontier constraint, plus a row summing all unknown cells up to
+    // the number of mines left; the rest is a single column
     //
-    std::vector<lp_row_info> rows; // used to set row names and constraints
+    std::ostringstream oss;
+    globalLp_.reset(new lp::problem);
+    auto& lp = *globalLp_;
     lp::matrix m;
+    auto& vars = globalVars_;
+    vars.clear(board_->cols());
     
-    for(size_t row = poi.row > kRange ? poi.row - kRange : 0;
-        row <= std::min(board_->rows() - 1, poi.row + kRange);
-        ++row) {
-        
-        for(size_t col = poi.col > kRange ? poi.col - kRange : 0;
-            col <= std::min(board_->cols() - 1, poi.col + kRange);
-            ++col) {
-            
-	    Location l{row, col};
-	    auto ci = board_->at(l);
-	    if (static_cast<int>(ci) < 0)
-		continue;
-	    
-	    auto pois = getNeighborhoodInfo(l);
-	    if (!pois.nr)
-		continue;
-	    
-	    oss.str("");
-	    oss << 'n' << l;
-	    rows.push_back({pois.mines_nr, oss.str()});
-	    
-	    for(uint8_t i = 0; i < pois.nr; ++i) {
-		// find/add column variable for an uncovered cell
-		auto iv = vars.insert({pois.coveredUnmarkedLocations[i], vars_nr + 1});
-		if (iv.second)
-		    ++vars_nr;
-		
-		// set coefficient to 1
-		m.add(rows.size(), iv.first->second, 1);
-	    }
+    int row{};
+    for(auto& info: gm.infos) {
+	lp.add_row_variables(1);
+	oss.str("");
+	oss << 'n' << gm.constraints[row];
+	lp.set_row_name(++row, oss.str().data());
+	lp.set_row_fixed_bound(row, info.mines_nr);
+	
+	for(uint8_t i = 0; i < info.nr; ++i) {
+	    auto& l = info.coveredUnmarkedLocations[i];
+	    vars.emplace(l, vars.size() + 1);
+	    m.add(row, vars.find(l), 1);
 	}
     }
     
-    if (!vars_nr)
-	return;
-    
-    //
-    // add variables, populate constraints
-    //
+    int rest = vars.size() + 1;
+    int total = row + 1;
+    lp.add_row_variables(1);
+    lp.set_row_name(total, "total");
+    lp.set_row_fixed_bound(total, gm.mines_left);
     
-    // add rows
-    lp->add_row_variables(rows.size());
-    for(size_t row = 0; row < rows.size(); ++row) {
-	lp->set_row_name(row + 1, rows[row].name.data());
-	lp->set_row_fixed_bound(row + 1, rows[row].fixed_value);
+    lp.add_column_variables(vars.size() + (gm.rest_nr ? 1 : 0));
+    for(auto i: vars.keys()) {
+	int col = vars.find(i);
+	oss.str("");
+	oss << 'u' << vars.location(i);
+	lp.set_column_name(col, oss.str().data());
+	lp.set_column_bounded(col, 0, 1);
+	m.add(total, col, 1);
     }
     
-    // add cols
-    lp->add_column_variables(vars.size());
-    for(auto v: vars) {
-	oss.str("");
-	oss << 'u' << v.first;
-	lp->set_column_name(v.second, oss.str().data());
-	lp->set_column_bounded(v.second, 0, 1);
+    if (gm.rest_nr) {
+	lp.set_column_name(rest, "rest");
+	lp.set_column_bounded(rest, 0, gm.rest_nr);
+	m.add(total, rest, 1);
     }
     
-    lp->set_matrix(m);
+    lp.set_matrix(m);
+    lp.set_probing(true);
     
-    if (!lp->presolve()) {
-	errlog << "ERROR: could not presolve: " << lp->last_errmsg()
-	       << "\npoi=" << poi
-	       << "\nLP: " << lp->dump() << "\n";
-	board_->dump_region(poi, kRange);
-	exit(-1);
-    }
+    return probe(poi, &lp, vars);
+}
+
+
+size_t GlpkSolver::globalRestBound(GlobalModel&, bool maximize) {
+    auto& lp = *globalLp_;
+    int rest = globalVars_.size() + 1;
+    lp.set_objective_coefficient(rest, 1);
+    if (maximize)
+	lp.set_maximize();
+    else
+	lp.set_minimize();
+    lp.solve();
+    ++stats_.lp_solves;
+    
+    auto v = lp.get_objective_value();
+    lp.set_objective_coefficient(rest, 0);
+    return maximize ? size_t(std::floor(v + kEpsilon)) : size_t(std::ceil(v - kEpsilon));
 }
 
 } // namespace miner
@@ -2,6 +2,7 @@
 
 #include "solver.h"
 #include "board.h"
+#include "glpk_region_model.h"
 
 namespace lp { class problem; }
 
@@ -11,14 +12,68 @@ class GlpkSolver : public Solver {
 public:
     static constexpr float kEpsilon = 1e-3;
     static constexpr size_t kRange = 7;
-    using Solver::Solver;
+    // models are checked for being abandoned once per this many solves
+    static constexpr size_t kCollectInterval = 1024;
+    explicit GlpkSolver(GameBoardPtr);
+    ~GlpkSolver() override;
     
-private:
-    // maps location to variable id in an LP
-    using VariablesMapType = std::unordered_map<Location, int>;
+    struct Stats {
+	size_t lp_solves{};
+	size_t simplex_iterations{};
+	size_t probes_skipped{}; // max/min solves avoided thanks to witnesses
+	size_t models_created{};
+	size_t models_deleted{};
+	GlpkRegionModel::SyncStats sync;
+    };
     
-    void prepare(lp::problem*, miner::Location, VariablesMapType&);
+    const Stats& stats() const { return stats_; }
+    size_t lpSolves() const override { return stats_.lp_solves; }
+    
+protected:
+    using VariablesMapType = GlpkRegionModel::VariablesMapType;
+    
+    enum : uint8_t {
+	kSeenSafe = 1,
+	kSeenMined = 2,
+    };
+    
+    // A persistent model together with the number of constraints it is the
+    // model of choice for.
+    struct Region {
+	explicit Region(size_t board_cols) : model{board_cols} {}
+	
+	GlpkRegionModel model;
+	size_t owned{};
+    };
+    
+    // owner_ of a constraint its region gave up, until deleteAbandoned()
+    static constexpr uint32_t kNoRegion = CellMap<uint32_t>::kNone - 1;
+    
+    uint32_t regionFor(const std::vector<Location>& constraints);
+    void updateOwners(uint32_t region, const std::vector<Location>& removed);
+    void collectRegions();
+    void deleteAbandoned(); // regions owning no constraints
+    bool solveComponent(Location poi, const std::vector<Location>& constraints);
+    bool probeGlobal(Location poi, GlobalModel&) override;
+    size_t globalRestBound(GlobalModel&, bool maximize) override;
+    // finds cells of "vars" which are forced to be safe or mined
+    bool probe(Location poi, lp::problem*, const VariablesMapType& vars);
     bool doPoi(miner::Location) override;
+    void windowChanged() override;
+    
+    std::vector<std::vector<Location>> components_;
+    std::vector<std::unique_ptr<Region>> regions_;
+    CellMap<uint32_t> owner_;   // constraint -> index of its region in regions_
+    CellMap<uint32_t> owners_;  // owner_ being renumbered by deleteAbandoned()
+    std::vector<uint32_t> renumbered_; // regions_ index -> new one, or kNoRegion
+    std::vector<std::pair<uint32_t, size_t>> votes_; // region, constraints, by regionFor()
+    std::vector<NeighborhoodInfo> infos_;
+    std::vector<Location> removed_;
+    std::vector<uint8_t> witnesses_; // kSeen* values seen per LP column
+    std::unique_ptr<lp::problem> globalLp_; // by probeGlobal()
+    VariablesMapType globalVars_;
+    size_t solves_nr_{};
+    Stats stats_;
 };
 
 } // namespace miner
@@ -22,7 +22,24 @@ int main(int argc, char** argv) {
     qRegisterMetaType<miner::Solver::FeedbackState>("miner::Solver::FeedbackState");
     qRegisterMetaType<miner::Location>("miner::Location");
     qRegisterMetaType<size_t>("size_t");
-    miner::MainWindow mw;
+    
+    QCommandLineParser args;
+    args.addHelpOption();
+    args.addOption({"solver", QString("Solver backend: %1.").arg(miner::SolverRegistry::names().data()), "name"});
+    args.addOption({"trace", "Trace each game to file, for miner_replay.", "file"});
+    args.process(q);
+    
+    auto backend = &miner::SolverRegistry::preferred();
+    if (args.isSet("solver")) {
+	backend = miner::SolverRegistry::find(args.value("solver").toStdString());
+	if (!backend) {
+	    std::cerr << "unknown solver " << args.value("solver").toStdString()
+		      << ", expected one of " << miner::SolverRegistry::names() << std::endl;
+	    return 2;
+	}
+    }
+    
+    miner::MainWindow mw{*backend, args.value("trace").toStdString()};
     mw.show();
     return q.exec();
 }
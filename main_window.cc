@@ -1,24 +1,18 @@
 #include "board.h"
 #include "game_board_widget.h"
 #include "main_window.h"
+#include "solver_registry.h"
 #include "ui_main_window.h"
 #include "ui_configure_field_dialog.h"
 
-#if ENABLE_GLPK_SOLVER
-#include "glpk_solver.h"
-#endif
-
-#if ENABLE_SOPLEX_SOLVER
-#include "soplex_solver.h"
-#endif
-
 namespace miner {
 
 MainWindow::~MainWindow() {
 }
 
 
-MainWindow::MainWindow() : ui_{new Ui::MainWindow} {
+MainWindow::MainWindow(const SolverRegistry::Backend& backend, const std::string& trace_path)
+  : ui_{new Ui::MainWindow}, trace_path_{trace_path}, backend_{&backend} {
     ui_->setupUi(this);
     
     ui_->scrollArea->setAlignment(Qt::AlignVCenter | Qt::AlignHCenter);
@@ -38,6 +32,18 @@ MainWindow::MainWindow() : ui_{new Ui::MainWindow} {
     connect(a, SIGNAL(triggered()), SLOT(gen_new()));
     ui_->toolBar->addAction(a);
     
+    a = new QAction("&Open", this);
+    a->setShortcuts({Qt::CTRL + Qt::Key_O});
+    a->setStatusTip("Open board file; the game is saved to it as it goes");
+    connect(a, SIGNAL(triggered()), SLOT(open_board()));
+    ui_->toolBar->addAction(a);
+    
+    a = new QAction("Sa&ve", this);
+    a->setShortcuts({Qt::CTRL + Qt::Key_S});
+    a->setStatusTip("Save board");
+    connect(a, SIGNAL(triggered()), SLOT(save_board()));
+    ui_->toolBar->addAction(a);
+    
     a = new QAction("&Configure", this);
     a->setShortcuts({Qt::CTRL + Qt::Key_C, Qt::Key_F3});
     a->setStatusTip("Configure field");
@@ -56,6 +62,16 @@ MainWindow::MainWindow() : ui_{new Ui::MainWindow} {
     a->setCheckable(true);
     connect(a, SIGNAL(toggled(bool)), SLOT(run_solver(bool)));
     ui_->toolBar->addAction(a);
+    
+    auto* solvers = new QComboBox(this);
+    solvers->setStatusTip("Solver backend");
+    for(auto& b: SolverRegistry::backends()) {
+	solvers->addItem(b.name);
+	solvers->setItemData(solvers->count() - 1, b.description, Qt::ToolTipRole);
+    }
+    solvers->setCurrentText(backend.name);
+    connect(solvers, SIGNAL(currentIndexChanged(int)), SLOT(solver_selected(int)));
+    ui_->toolBar->addWidget(solvers);
 
     a = new QAction("-", this);
     a->setStatusTip("Zoom out");
@@ -84,17 +100,10 @@ MainWindow::MainWindow() : ui_{new Ui::MainWindow} {
 
 
 void MainWindow::setup_solver() {
-    auto board = game_board_widget_->board();
-    
-#ifdef ENABLE_SOPLEX_SOLVER
-    solver_.reset(new SoplexSolver{board});
-    
-#elif ENABLE_GLPK_SOLVER
-    solver_.reset(new GlpkSolver{board});
-#else
-    #error Enable at least one solver
-#endif
-    
+    solver_ = SolverRegistry::create(*backend_, game_board_widget_->board(),
+				     std::thread::hardware_concurrency());
+    if (trace_)
+	solver_->setTrace(trace_);
     solver_->setResultHandler([this](auto ft, miner::Location l, size_t range){
 	    //QThread::usleep(0); // slow down a bit for nice animation effect
 	    QMetaObject::invokeMethod(
@@ -107,18 +116,104 @@ void MainWindow::setup_solver() {
 }
 
 
-void MainWindow::gen_new() {
-    show_mines_action_->setChecked(false);
+void MainWindow::solver_selected(int index) {
+    backend_ = &SolverRegistry::backends().at(index);
+    run_solver_action_->setChecked(false);
+    setup_solver();
+    if (trace_)
+	trace_->backend_changed(backend_->name);
     
+    // the new solver picks up where the old one stopped
+    std::vector<Location> pois;
+    game_board_widget_->board()->frontier(pois);
+    for(auto& l: pois)
+	solver_->addPoi(l);
+}
+
+
+void MainWindow::gen_new() {
     auto field = std::make_shared<Field>();
-    field->gen_random(new_rows_, new_cols_, new_mines_);
+    if (new_rows_ * new_cols_ > BitPlane::kMaxDenseCells)
+	field->gen_lazy(new_rows_, new_cols_, new_mines_, time(nullptr));
+    else
+	field->gen_random(new_rows_, new_cols_, new_mines_);
     
     auto board = std::make_shared<GameBoard>();
     board->set_field(field);
+    if (!trace_path_.empty()) {
+	solver_.reset(); // done with the previous trace before its file is reused
+	trace_.reset();
+	try {
+	    trace_ = std::make_shared<SolverTrace>(trace_path_, *field, backend_->name);
+	} catch(const i::exception& e) {
+	    QMessageBox::warning(this, "Miner", QString("Can't trace the game:\n%1").arg(e.what()));
+	}
+    }
+    show_board(board);
+    file_.reset(); // after the old board's solver is gone
+}
+
+
+void MainWindow::show_board(GameBoardPtr board) {
+    show_mines_action_->setChecked(false);
+    run_solver_action_->setChecked(false);
     game_board_widget_->set_board(board);
     setup_solver();
+    
+    std::vector<Location> pois;
+    board->frontier(pois);
+    for(auto& l: pois)
+	solver_->addPoi(l);
+    
     update_cell_info();
-    game_board_widget_->set_rw(true);
+    game_board_widget_->set_rw(!board->game_lost());
+    if (board->game_lost())
+	show_mines_action_->setChecked(true);
+}
+
+
+void MainWindow::open_board() {
+    auto path = QFileDialog::getOpenFileName(this, "Open board", {}, "Miner boards (*.mbf)");
+    if (path.isEmpty())
+	return;
+    
+    try {
+	std::unique_ptr<BoardFile> file{new BoardFile};
+	auto board = file->open(path.toStdString(), BoardFile::Mode::kShared);
+	new_rows_ = board->rows();
+	new_cols_ = board->cols();
+	new_mines_ = board->field()->mines_nr();
+	trace_.reset();
+	show_board(board);
+	file_ = std::move(file);
+    } catch(const i::exception& e) {
+	QMessageBox::warning(this, "Miner", QString("Can't open %1:\n%2").arg(path, e.what()));
+    }
+}
+
+
+// Boards opened from a file are saved to it, others to a new one.
+void MainWindow::save_board() {
+    QString path;
+    if (!file_) {
+	path = QFileDialog::getSaveFileName(this, "Save board", {}, "Miner boards (*.mbf)");
+	if (path.isEmpty())
+	    return;
+    }
+    
+    // the planes and counters are written as of one moment, which the solver
+    // would move on from, allocating tiles as the writer walks them
+    bool was_running = solver_->suspendAndWait();
+    try {
+	if (file_)
+	    file_->sync();
+	else
+	    BoardFile::save(*game_board_widget_->board(), path.toStdString());
+    } catch(const i::exception& e) {
+	QMessageBox::warning(this, "Miner", QString("Can't save the board:\n%1").arg(e.what()));
+    }
+    if (was_running)
+	solver_->resume();
 }
 
 
@@ -170,7 +265,23 @@ void MainWindow::action_about() {
 
 
 void MainWindow::cell_changed(miner::Location l) {
-    solver_->addPoi(l);
+    auto& board = *game_board_widget_->board();
+    if (trace_)
+	trace_->record_move(board, l);
+    
+    if (board.at(l) != GameBoard::CellInfo::N0) {
+	solver_->addPoi(l);
+	
+    } else {
+	// the whole zero region opens at once, and only its border is news to solver
+	std::vector<Location> border;
+	auto area = board.open_zeros(l, border);
+	for(auto& c: border)
+	    solver_->addPoi(c);
+	game_board_widget_->update_box(
+	  {(area.row0 + area.row1) / 2, (area.col0 + area.col1) / 2},
+	  std::max(area.row1 - area.row0, area.col1 - area.col0) / 2 + 1);
+    }
     update_cell_info();
 }
 
@@ -188,6 +299,8 @@ void MainWindow::update_cell_info() {
 void MainWindow::game_lost() {
     game_board_widget_->board()->set_game_lost();
     show_mines_action_->setChecked(true);
+    if (trace_)
+	trace_->flush();
 }
 
 
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "board_file.h"
 #include "field.h"
 #include "solver.h"
+#include "solver_registry.h"
 
 namespace Ui { class MainWindow; }
 
@@ -12,27 +14,38 @@ class GameBoardWidget;
 class MainWindow : public QMainWindow {
     Q_OBJECT;
 public:
-    MainWindow();
+    // With trace_path, each new game is traced to it (see SolverTrace),
+    // replacing the previous game's trace.
+    explicit MainWindow(const SolverRegistry::Backend& = SolverRegistry::preferred(),
+			const std::string& trace_path = {});
     ~MainWindow();
                  
 private slots:
     void action_about();
     void gen_new();
+    void open_board();
+    void save_board();
     void configure_field();
     void show_mines_toggled(bool);
     void run_solver(bool);
     void cell_changed(miner::Location);
     void game_lost();
+    void solver_selected(int);
     void solver_result_slot(
       miner::Solver::FeedbackState, miner::Location center, size_t range);
     
 private:
     void update_cell_info();
     void setup_solver();
+    void show_board(GameBoardPtr);
     
     std::unique_ptr<Ui::MainWindow> ui_;
     GameBoardWidget* game_board_widget_{};
+    std::unique_ptr<BoardFile> file_; // the board is played in, if opened; outlives solver_
+    std::string trace_path_;
+    SolverTracePtr trace_; // of the current game, unless it was opened from a file
     std::unique_ptr<Solver> solver_{};
+    const SolverRegistry::Backend* backend_{};
     
     size_t new_rows_{3};
     size_t new_cols_{3};
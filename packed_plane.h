@@ -0,0 +1,263 @@
+#pragma once
+
+namespace miner {
+
+enum class PlaneStorage : uint8_t {
+    kAuto, // tiled for planes of more than kMaxDenseCells cells
+    kDense,
+    kTiled,
+};
+
+//
+// Row-major grid of kBits-wide unsigned values packed into 64-bit words.
+// Rows are padded to a multiple of 64 cells, so whole-row operations can be
+// done word-wise (see bit_kernels.h) and word w of a bit-plane row covers the
+// same cells as words [w * kBits, (w + 1) * kBits) of any other plane of the
+// same size. Bits past the last column are always zero.
+//
+// Tiled storage cuts the grid into 64x64-cell tiles, allocated on the first
+// write of a nonzero value; cells of other tiles read as zero. Tiles are
+// found through a directory of 1024x1024-cell blocks, also allocated on
+// demand, so an untouched huge plane costs a null pointer per block. Tile
+// rows are kBits words, laid out like the words of a dense row. row_data()
+// is for dense storage only; word(), words() and for_each_block() work with
+// either. Tiles written since clear_dirty() are marked dirty, for writing
+// back only those (see BoardFile::sync()); dense storage doesn't track it.
+//
+// Dense storage may also be memory owned by someone else, e.g. a mapped file
+// (see map()); copies of such a plane own their words.
+//
+template<unsigned kBits>
+class PackedPlane {
+public:
+    static_assert(kBits && 64 % kBits == 0, "kBits must divide 64");
+    static constexpr unsigned kPerWord = 64 / kBits;
+    static constexpr uint64_t kValueMask = kBits == 64 ? ~uint64_t{} : (uint64_t{1} << kBits) - 1;
+    static constexpr size_t kTileSize = 64; // rows and columns of a tile
+    static constexpr size_t kMaxDenseCells = size_t{1} << 28;
+
+    PackedPlane() = default;
+    PackedPlane(const PackedPlane& other) { *this = other; }
+    PackedPlane(PackedPlane&&) = default; // vectors keep their buffers, so data_ stays valid
+    PackedPlane& operator=(PackedPlane&&) = default;
+
+    PackedPlane& operator=(const PackedPlane& other) {
+        rows_ = other.rows_;
+        cols_ = other.cols_;
+        stride_ = other.stride_;
+        tiled_ = other.tiled_;
+        block_cols_ = other.block_cols_;
+        owner_.reset();
+        words_.assign(other.data_, other.data_ + (other.tiled_ ? 0 : rows_ * stride_));
+        data_ = words_.data();
+        blocks_.clear();
+        blocks_.resize(other.blocks_.size());
+        for(size_t b = 0; b < blocks_.size(); ++b) {
+            if (!other.blocks_[b])
+                continue;
+            blocks_[b].reset(new Block{});
+            std::copy(other.blocks_[b]->dirty, other.blocks_[b]->dirty + kBlockTiles * kBlockTiles,
+                      blocks_[b]->dirty);
+            for(size_t t = 0; t < kBlockTiles * kBlockTiles; ++t)
+                if (auto src = other.blocks_[b]->tiles[t].get()) {
+                    blocks_[b]->tiles[t].reset(new uint64_t[kTileWords]);
+                    std::copy(src, src + kTileWords, blocks_[b]->tiles[t].get());
+                }
+        }
+        return *this;
+    }
+
+    void reset(size_t rows, size_t cols, PlaneStorage storage = PlaneStorage::kAuto) {
+        rows_ = rows;
+        cols_ = cols;
+        stride_ = (cols + 63) / 64 * kBits;
+        tiled_ = storage == PlaneStorage::kTiled
+            or (storage == PlaneStorage::kAuto and rows * cols > kMaxDenseCells);
+        blocks_.clear();
+        owner_.reset();
+        if (tiled_) {
+            std::vector<uint64_t>{}.swap(words_);
+            block_cols_ = (cols + kBlockSize - 1) / kBlockSize;
+            blocks_.resize((rows + kBlockSize - 1) / kBlockSize * block_cols_);
+        } else {
+            words_.assign(rows_ * stride_, 0);
+        }
+        data_ = words_.data();
+    }
+
+    // Makes the plane dense storage in rows * words_per_row() words at
+    // "words", which "owner" keeps alive.
+    void map(size_t rows, size_t cols, uint64_t* words, std::shared_ptr<const void> owner) {
+        rows_ = rows;
+        cols_ = cols;
+        stride_ = (cols + 63) / 64 * kBits;
+        tiled_ = false;
+        blocks_.clear();
+        std::vector<uint64_t>{}.swap(words_);
+        data_ = words;
+        owner_ = std::move(owner);
+    }
+
+    bool tiled() const { return tiled_; }
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    size_t words_per_row() const { return stride_; }
+
+    unsigned get(size_t row, size_t col) const {
+        if (tiled_) {
+            auto t = tile(row, col);
+            return t ? extract(t[tile_word(row, col / kPerWord)], col) : 0;
+        }
+        if (kBits == 8)
+            return row_bytes(row)[col];
+        return extract(data_[row * stride_ + col / kPerWord], col);
+    }
+
+    void set(size_t row, size_t col, unsigned v) {
+        uint64_t* w;
+        if (tiled_) {
+            auto t = written_tile(row, col, v & kValueMask);
+            if (!t)
+                return;
+            w = t + tile_word(row, col / kPerWord);
+        } else {
+            w = &data_[row * stride_ + col / kPerWord];
+        }
+        *w = (*w & ~(kValueMask << shift(col))) | ((uint64_t(v) & kValueMask) << shift(col));
+    }
+
+    // sets all cells of word w of a row; bits past the last column must be zero
+    void set_word(size_t row, size_t w, uint64_t v) {
+        if (!tiled_) {
+            data_[row * stride_ + w] = v;
+            return;
+        }
+        auto t = written_tile(row, w * kPerWord, v);
+        if (t)
+            t[tile_word(row, w)] = v;
+    }
+
+    // word w of a row, i.e. cells [w * kPerWord, (w + 1) * kPerWord)
+    uint64_t word(size_t row, size_t w) const {
+        if (!tiled_)
+            return data_[row * stride_ + w];
+        auto t = tile(row, w * kPerWord);
+        return t ? t[tile_word(row, w)] : 0;
+    }
+
+    // Words of a row from word w on which are contiguous in memory; "nr" of
+    // them, up to the end of the row or of the tile. Untouched tiles read as
+    // zeros.
+    const uint64_t* words(size_t row, size_t w, size_t& nr) const {
+        if (!tiled_) {
+            nr = stride_ - w;
+            return row_data(row) + w;
+        }
+        nr = kBits - w % kBits;
+        auto t = tile(row, w * kPerWord);
+        return t ? t + tile_word(row, w) : zeros() + w % kBits;
+    }
+
+    // Calls f(row0, rows, word0, words) for each part of the plane which may
+    // hold nonzero values: the whole plane if dense, allocated tiles if tiled.
+    // "dirty_only" skips the tiles not written since clear_dirty().
+    template<class F>
+    void for_each_block(F&& f, bool dirty_only = false) const {
+        if (!tiled_) {
+            if (rows_ and stride_)
+                f(size_t{0}, rows_, size_t{0}, stride_);
+            return;
+        }
+        for(size_t b = 0; b < blocks_.size(); ++b) {
+            if (!blocks_[b])
+                continue;
+            for(size_t t = 0; t < kBlockTiles * kBlockTiles; ++t) {
+                if (!blocks_[b]->tiles[t] or (dirty_only and !blocks_[b]->dirty[t]))
+                    continue;
+                auto row0 = b / block_cols_ * kBlockSize + t / kBlockTiles * kTileSize;
+                auto col0 = b % block_cols_ * kBlockSize + t % kBlockTiles * kTileSize;
+                f(row0, std::min(kTileSize, rows_ - row0), col0 / kPerWord, size_t{kBits});
+            }
+        }
+    }
+
+    void clear_dirty() {
+        for(auto& b: blocks_)
+            if (b)
+                std::fill(b->dirty, b->dirty + kBlockTiles * kBlockTiles, 0);
+    }
+
+    // dense storage only
+    const uint64_t* row_data(size_t row) const { return data_ + row * stride_; }
+    uint64_t* row_data(size_t row) { return data_ + row * stride_; }
+    const uint8_t* row_bytes(size_t row) const { return reinterpret_cast<const uint8_t*>(row_data(row)); }
+    uint8_t* row_bytes(size_t row) { return reinterpret_cast<uint8_t*>(row_data(row)); }
+
+    // mask of meaningful bits in the last word of each row
+    uint64_t last_word_mask() const {
+        auto bits = (cols_ % kPerWord) * kBits;
+        return bits ? (uint64_t{1} << bits) - 1 : ~uint64_t{};
+    }
+
+private:
+    static constexpr size_t kBlockTiles = 16; // tiles per block row and column
+    static constexpr size_t kBlockSize = kBlockTiles * kTileSize;
+    static constexpr size_t kTileWords = kTileSize * kBits;
+
+    struct Block {
+        std::unique_ptr<uint64_t[]> tiles[kBlockTiles * kBlockTiles];
+        uint8_t dirty[kBlockTiles * kBlockTiles]; // bytes, which threads writing other tiles don't share
+    };
+
+    static unsigned shift(size_t col) { return (col % kPerWord) * kBits; }
+    static unsigned extract(uint64_t w, size_t col) { return (w >> shift(col)) & kValueMask; }
+    static size_t tile_word(size_t row, size_t w) { return row % kTileSize * kBits + w % kBits; }
+
+    static const uint64_t* zeros() {
+        static const uint64_t rv[kBits]{};
+        return rv;
+    }
+
+    const uint64_t* tile(size_t row, size_t col) const {
+        auto& b = blocks_[row / kBlockSize * block_cols_ + col / kBlockSize];
+        if (!b)
+            return nullptr;
+        return b->tiles[row % kBlockSize / kTileSize * kBlockTiles + col % kBlockSize / kTileSize].get();
+    }
+
+    // Tile of a cell about to be written, marked dirty. Missing tiles are
+    // allocated if "allocate", else null is returned.
+    uint64_t* written_tile(size_t row, size_t col, bool allocate) {
+        auto& b = blocks_[row / kBlockSize * block_cols_ + col / kBlockSize];
+        if (!b) {
+            if (!allocate)
+                return nullptr;
+            b.reset(new Block{});
+        }
+        auto i = row % kBlockSize / kTileSize * kBlockTiles + col % kBlockSize / kTileSize;
+        auto& t = b->tiles[i];
+        if (!t) {
+            if (!allocate)
+                return nullptr;
+            t.reset(new uint64_t[kTileWords]());
+        }
+        b->dirty[i] = 1;
+        return t.get();
+    }
+
+    size_t rows_{};
+    size_t cols_{};
+    size_t stride_{}; // words per row
+    bool tiled_{};
+    size_t block_cols_{};
+    std::vector<uint64_t> words_;               // dense storage, unless mapped
+    uint64_t* data_{};                          // dense words, in words_ or mapped
+    std::shared_ptr<const void> owner_;         // of mapped words
+    std::vector<std::unique_ptr<Block>> blocks_; // tiled storage
+};
+
+using BitPlane = PackedPlane<1>;
+using NibblePlane = PackedPlane<4>;
+using BytePlane = PackedPlane<8>;
+
+} // namespace miner
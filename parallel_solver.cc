@@ -0,0 +1,284 @@
+#include "parallel_solver.h"
+
+namespace miner {
+
+namespace {
+
+// deduced cells of a worker thread's current claim
+thread_local std::vector<Location>* t_found{};
+
+} // namespace
+
+
+ParallelSolver::ParallelSolver(GameBoardPtr board, BackendFactory factory, size_t workers_nr)
+    : Solver{board} {
+
+    tile_rows_ = (board->rows() + kTileSize - 1) / kTileSize;
+    tile_cols_ = (board->cols() + kTileSize - 1) / kTileSize;
+    tiles_.resize(tile_rows_ * tile_cols_);
+    queued_.reset(board->rows(), board->cols());
+
+    workers_.resize(std::max<size_t>(1, workers_nr));
+    ready_.resize(workers_.size());
+    for(auto& w: workers_) {
+	w.backend = factory(board);
+	w.backend->setParent(this);
+	w.backend->setResultHandler([this](FeedbackState s, Location l, size_t range) {
+		resultHandler_(s, l, range);
+	    });
+    }
+}
+
+
+ParallelSolver::~ParallelSolver() {
+    stop();
+    if (thread_.joinable())
+	thread_.join();
+    stopWorkers();
+}
+
+
+Solver::Window ParallelSolver::windowOf(size_t tile) const {
+    auto row = tile / tile_cols_, col = tile % tile_cols_;
+    return {
+	(row ? row - 1 : 0) * kTileSize,
+	(col ? col - 1 : 0) * kTileSize,
+	std::min(board_->rows(), (row + 2) * kTileSize),
+	std::min(board_->cols(), (col + 2) * kTileSize),
+    };
+}
+
+
+template<class F>
+void ParallelSolver::forBlock(size_t tile, F&& f) {
+    auto row = tile / tile_cols_, col = tile % tile_cols_;
+    for(auto r = row ? row - 1 : 0; r <= std::min(tile_rows_ - 1, row + 1); ++r)
+	for(auto c = col ? col - 1 : 0; c <= std::min(tile_cols_ - 1, col + 1); ++c)
+	    f(r * tile_cols_ + c);
+}
+
+
+void ParallelSolver::addPoi(Location l) {
+    if (trace_)
+	trace_->record(SolverTrace::Event::kAddPoi, l);
+    if (t_found) {
+	t_found->push_back(l);
+	return;
+    }
+
+    std::lock_guard<std::mutex> lock{sched_mtx_};
+    schedule(l);
+    sched_cond_.notify_all();
+}
+
+
+void ParallelSolver::schedule(Location l, bool fresh) {
+    if (queued_.get(l.row, l.col)) {
+	poiStats_.deduplicated += fresh;
+	return;
+    }
+    queued_.set(l.row, l.col, 1);
+    poiStats_.enqueued += fresh;
+
+    auto t = tileOf(l);
+    auto& tile = tiles_[t];
+    tile.pois.push_back(l);
+    ++pending_;
+    if (!tile.ready) {
+	tile.ready = true;
+	ready_[homeOf(t)].push_back(t);
+    }
+}
+
+
+bool ParallelSolver::claim(size_t worker, Claim& c) {
+    auto n = workers_.size();
+    for(size_t k = 0; k < n; ++k) {
+	// own tiles are taken from the front, stolen ones from the back
+	auto& q = ready_[(worker + k) % n];
+	for(size_t j = 0; j < q.size(); ++j) {
+	    auto i = k ? q.size() - 1 - j : j;
+	    auto t = q[i];
+
+	    bool free = true;
+	    forBlock(t, [&](size_t b) { free = free and !tiles_[b].locks; });
+	    if (!free)
+		continue;
+
+	    q.erase(q.begin() + i);
+	    forBlock(t, [&](size_t b) { ++tiles_[b].locks; });
+
+	    auto& tile = tiles_[t];
+	    tile.ready = false;
+	    c.tile = t;
+	    c.pois.clear();
+	    c.pois.swap(tile.pois);
+	    c.local = 0;
+	    for(auto& l: c.pois)
+		queued_.set(l.row, l.col, 0);
+	    pending_ -= c.pois.size();
+	    ++busy_;
+	    return true;
+	}
+    }
+
+    return false;
+}
+
+
+void ParallelSolver::release(size_t worker, const Claim& c, size_t solved_nr) {
+    forBlock(c.tile, [&](size_t b) { --tiles_[b].locks; });
+
+    poiStats_.enqueued += c.local;
+    poiStats_.solved += solved_nr;
+    for(auto& l: c.pois)
+	schedule(l, false);
+    for(auto& l: workers_[worker].found)
+	schedule(l);
+    workers_[worker].found.clear();
+
+    --busy_;
+    sched_cond_.notify_all();
+}
+
+
+void ParallelSolver::work(size_t id) {
+    auto& worker = workers_[id];
+    t_found = &worker.found;
+
+    Claim c;
+    while(true) {
+	{
+	    std::unique_lock<std::mutex> lock{sched_mtx_};
+	    sched_cond_.wait(lock, [&] { return exit_ or (running_ and claim(id, c)); });
+	    if (exit_)
+		return;
+	}
+
+	worker.backend->setWindow(windowOf(c.tile));
+
+	bool ok = true;
+	size_t i = 0;
+	for(; i < c.pois.size() and ok and running_; ++i) {
+	    ok = worker.backend->solvePoi(c.pois[i]);
+	    if (ok)
+		resultHandler_(FeedbackState::kSolved, c.pois[i], kUpdateRange);
+
+	    // cells deduced in the claimed tile can be solved right away
+	    auto& found = worker.found;
+	    auto own = std::partition(found.begin(), found.end(),
+                                      [&](Location l) { return tileOf(l) != c.tile; });
+	    c.local += found.end() - own;
+	    c.pois.insert(c.pois.end(), own, found.end());
+	    found.erase(own, found.end());
+	}
+	c.pois.erase(c.pois.begin(), c.pois.begin() + i);
+
+	std::lock_guard<std::mutex> lock{sched_mtx_};
+	if (!ok) {
+	    lost_ = true;
+	    running_ = false;
+	}
+	release(id, c, i);
+    }
+}
+
+
+void ParallelSolver::startWorkers() {
+    if (workers_[0].thread.joinable())
+	return;
+
+    exit_ = false;
+    for(size_t i = 0; i < workers_.size(); ++i)
+	workers_[i].thread = std::thread(&ParallelSolver::work, this, i);
+}
+
+
+void ParallelSolver::stopWorkers() {
+    {
+	std::lock_guard<std::mutex> lock{sched_mtx_};
+	exit_ = true;
+	sched_cond_.notify_all();
+    }
+
+    for(auto& w: workers_)
+	if (w.thread.joinable())
+	    w.thread.join();
+}
+
+
+bool ParallelSolver::doPoi(Location poi) {
+    {
+	std::lock_guard<std::mutex> lock{sched_mtx_};
+	schedule(poi);
+    }
+    return solveQueued();
+}
+
+
+bool ParallelSolver::solveQueued() {
+    startWorkers();
+
+    std::unique_lock<std::mutex> lock{sched_mtx_};
+    running_ = true;
+    sched_cond_.notify_all();
+
+    sched_cond_.wait(lock, [&] { return idle() or lost_; });
+    running_ = false;
+    sched_cond_.wait(lock, [&] { return !busy_; });
+    return !lost_;
+}
+
+
+void ParallelSolver::setTrace(SolverTracePtr t) {
+    for(auto& w: workers_)
+	w.backend->setTrace(t);
+    Solver::setTrace(std::move(t));
+}
+
+
+size_t ParallelSolver::lpSolves() const {
+    size_t rv{};
+    for(auto& w: workers_)
+	rv += w.backend->lpSolves();
+    return rv;
+}
+
+
+PoiScheduler::Stats ParallelSolver::poiStats() const {
+    std::lock_guard<std::mutex> lock{sched_mtx_};
+    return poiStats_;
+}
+
+
+void ParallelSolver::asyncSolver() {
+    startWorkers();
+
+    while(okToRun()) {
+	std::unique_lock<std::mutex> lock{sched_mtx_};
+	running_ = true;
+	sched_cond_.notify_all();
+
+	// let workers go until they run out of POIs or get suspended
+	while(!idle() and !lost_ and state_ == RunState::kRunning)
+	    sched_cond_.wait_for(lock, std::chrono::milliseconds(10));
+
+	running_ = false;
+	sched_cond_.wait(lock, [&] { return !busy_; });
+
+	if (lost_) {
+	    setState(RunState::kExit);
+	    break;
+	}
+
+	if (state_ == RunState::kRunning) {
+	    setState(RunState::kSuspended);
+	    lock.unlock();
+	    resultHandler_(FeedbackState::kSuspended, Location{}, 0);
+	}
+    }
+
+    stopWorkers();
+}
+
+} // namespace miner
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "solver.h"
+
+namespace miner {
+
+//
+// Runs several backend solvers over one board. POIs are queued per tile; a
+// worker claims a tile with the ring of tiles around it, which must not
+// overlap any other claim, and solves the tile's POIs with its backend
+// limited to that block (see Solver::setWindow). Tiles are as wide as a
+// multiple of 64 cells, so claimed blocks never share words of the board's
+// bit-planes. Workers prefer tiles of their own stripe of the board and
+// steal from other stripes when they run out.
+//
+class ParallelSolver : public Solver {
+public:
+    static constexpr size_t kTileSize = 64;
+
+    using BackendFactory = std::function<std::unique_ptr<Solver>(GameBoardPtr)>;
+
+    ParallelSolver(GameBoardPtr, BackendFactory, size_t workers_nr);
+    ~ParallelSolver() override;
+
+    void addPoi(Location) override;
+    bool solveQueued() override;
+    size_t lpSolves() const override;
+    void setTrace(SolverTracePtr) override; // and of the workers' backends
+    PoiScheduler::Stats poiStats() const override;
+
+    // board must be larger than this for parallel solving to pay off, and
+    // dense: tiles of a sparse huge board wouldn't fit in memory
+    static bool worthIt(const GameBoard& b) {
+	return !b.tiled() and (b.rows() > 3 * kTileSize or b.cols() > 3 * kTileSize);
+    }
+
+protected:
+    // Solves POI and everything it leads to, blocking until all workers are idle.
+    bool doPoi(Location) override;
+    void asyncSolver() override;
+
+private:
+    struct Tile {
+	std::vector<Location> pois;
+	uint8_t locks{}; // claims covering this tile
+	bool ready{};    // listed in its worker's ready_
+    };
+
+    struct Claim {
+	size_t tile;
+	std::vector<Location> pois;
+	size_t local{}; // POIs added by the claim's worker itself
+    };
+
+    struct Worker {
+	std::unique_ptr<Solver> backend;
+	std::thread thread;
+	std::vector<Location> found; // deduced cells, not scheduled yet
+    };
+
+    size_t tileOf(Location l) const { return l.row / kTileSize * tile_cols_ + l.col / kTileSize; }
+    size_t homeOf(size_t tile) const { return tile / tile_cols_ * workers_.size() / tile_rows_; }
+    Window windowOf(size_t tile) const;
+    template<class F> void forBlock(size_t tile, F&& f);
+
+    // "fresh" is false for POIs returned by a claim, which were counted already
+    void schedule(Location, bool fresh = true);
+    bool claim(size_t worker, Claim&);
+    void release(size_t worker, const Claim&, size_t solved_nr);
+    bool idle() const { return !busy_ and !pending_; }
+    void work(size_t worker);
+    void startWorkers();
+    void stopWorkers();
+
+    std::vector<Worker> workers_;
+    std::vector<Tile> tiles_;
+    size_t tile_rows_{}, tile_cols_{};
+    std::vector<std::deque<size_t>> ready_; // tiles with POIs, by home worker
+    BitPlane queued_;                       // cells in some tile's POIs
+    PoiScheduler::Stats poiStats_;
+
+    mutable std::mutex sched_mtx_; // protects everything above but backends
+    std::condition_variable sched_cond_;
+    size_t pending_{};            // queued POIs
+    size_t busy_{};               // workers holding a claim
+    std::atomic<bool> running_{}; // workers may claim tiles
+    bool exit_{};
+    bool lost_{};
+};
+
+} // namespace miner
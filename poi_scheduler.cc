@@ -0,0 +1,66 @@
+#include "poi_scheduler.h"
+
+namespace miner {
+
+void PoiScheduler::reset(size_t rows, size_t cols) {
+    queued_.reset(rows, cols);
+    priority_.reset(rows, cols);
+    for(auto& b: buckets_)
+        b.clear();
+    nonEmpty_ = 0;
+    size_ = 0;
+}
+
+
+void PoiScheduler::raise(size_t row, size_t col) {
+    auto p = priority_.get(row, col);
+    if (p == kMaxPriority)
+        return;
+
+    priority_.set(row, col, ++p);
+    buckets_[p].emplace_back(row, col);
+    nonEmpty_ |= 1u << p;
+}
+
+
+void PoiScheduler::push(Location l) {
+    if (queued_.get(l.row, l.col)) {
+        ++stats_.deduplicated;
+    } else {
+        queued_.set(l.row, l.col, 1);
+        priority_.set(l.row, l.col, 0);
+        ++size_;
+        ++stats_.enqueued;
+    }
+    raise(l.row, l.col);
+
+    for(auto row = i::subtract_floor_0(l.row, 1); row <= std::min(queued_.rows() - 1, l.row + size_t{1}); ++row)
+        for(auto col = i::subtract_floor_0(l.col, 1); col <= std::min(queued_.cols() - 1, l.col + size_t{1}); ++col)
+            if ((row != l.row or col != l.col) and queued_.get(row, col))
+                raise(row, col);
+}
+
+
+bool PoiScheduler::pop(Location& l) {
+    while(nonEmpty_) {
+        unsigned p = 31 - __builtin_clz(nonEmpty_);
+        auto& bucket = buckets_[p];
+        l = bucket.front();
+        bucket.pop_front();
+        if (bucket.empty())
+            nonEmpty_ &= ~(1u << p);
+
+        // skip entries left behind by raise()
+        if (!queued_.get(l.row, l.col) or priority_.get(l.row, l.col) != p)
+            continue;
+
+        queued_.set(l.row, l.col, 0);
+        --size_;
+        ++stats_.solved;
+        return true;
+    }
+
+    return false;
+}
+
+} // namespace miner
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "field.h"
+
+namespace miner {
+
+//
+// Queue of cells to solve around (POIs) which holds every cell at most once.
+// A cell's priority is the number of changes to it and its neighbors since
+// it was queued, so neighborhoods which changed the most are solved first,
+// and in FIFO order within a priority. Raising a priority pushes the cell
+// into a higher bucket and leaves a stale entry behind, which is dropped
+// when it reaches the front; all operations are O(1).
+//
+class PoiScheduler {
+public:
+    static constexpr unsigned kMaxPriority = 15;
+
+    struct Stats {
+        size_t enqueued{};     // cells put into the queue
+        size_t deduplicated{}; // pushes of cells already in the queue
+        size_t solved{};       // cells taken out of the queue
+    };
+
+    void reset(size_t rows, size_t cols);
+    bool sized() const { return queued_.rows(); }
+
+    // Reports a change of cell l: queues it and raises priorities of its
+    // queued neighbors.
+    void push(Location l);
+    // Takes out a cell of the highest priority; returns false if empty.
+    bool pop(Location& l);
+
+    size_t size() const { return size_; }
+    bool empty() const { return !size_; }
+    const Stats& stats() const { return stats_; }
+
+private:
+    void raise(size_t row, size_t col);
+
+    BitPlane queued_;
+    BytePlane priority_;
+    std::array<std::deque<Location>, kMaxPriority + 1> buckets_;
+    uint32_t nonEmpty_{}; // bit per non-empty bucket
+    size_t size_{};
+    Stats stats_;
+};
+
+} // namespace miner
@@ -0,0 +1,680 @@
+#include "probability.h"
+
+namespace miner {
+
+namespace {
+
+// A limb product, with its carries, costs about this much less than a
+// backtracking step.
+constexpr size_t kLimbOpsPerStep = 8;
+
+
+double log_choose(double n, double k) {
+    return std::lgamma(n + 1) - std::lgamma(k + 1) - std::lgamma(n - k + 1);
+}
+
+
+// Unsigned integer of any size, with just what exact layout weights take.
+class BigUint {
+public:
+    BigUint() = default;
+    explicit BigUint(uint64_t v) {
+        for(; v; v >>= 32)
+            limbs_.push_back(uint32_t(v));
+    }
+
+    bool zero() const { return limbs_.empty(); }
+
+    BigUint& operator*=(uint64_t v) {
+        if (v >> 32) {
+            BigUint rv;
+            rv.add_product(*this, BigUint{v});
+            return *this = std::move(rv);
+        }
+
+        uint64_t carry{};
+        for(auto& l: limbs_) {
+            carry += uint64_t(l) * v;
+            l = uint32_t(carry);
+            carry >>= 32;
+        }
+        if (carry)
+            limbs_.push_back(uint32_t(carry));
+        if (!v)
+            limbs_.clear();
+        return *this;
+    }
+
+    // adds a * b
+    void add_product(const BigUint& a, const BigUint& b) {
+        if (a.zero() or b.zero())
+            return;
+        // room for the larger of the two, plus a carry
+        limbs_.resize(std::max(limbs_.size(), a.limbs_.size() + b.limbs_.size()) + 1);
+
+        for(size_t i = 0; i < a.limbs_.size(); ++i) {
+            uint64_t carry{}, ai = a.limbs_[i];
+            size_t k = i;
+            for(auto bj: b.limbs_) {
+                // at most (2^32 - 1)^2 + 2 * (2^32 - 1), which fits
+                carry += ai * bj + limbs_[k];
+                limbs_[k++] = uint32_t(carry);
+                carry >>= 32;
+            }
+            for(; carry; ++k) {
+                carry += limbs_[k];
+                limbs_[k] = uint32_t(carry);
+                carry >>= 32;
+            }
+        }
+        while(!limbs_.empty() and !limbs_.back())
+            limbs_.pop_back();
+    }
+
+    // this / d, rounded to a double
+    double ratio(const BigUint& d) const {
+        int e, de;
+        auto m = top(e), dm = d.top(de);
+        return dm ? std::ldexp(m / dm, e - de) : NAN;
+    }
+
+private:
+    // the value is about the result * 2^e, from its top three limbs
+    double top(int& e) const {
+        auto n = limbs_.size();
+        double rv{};
+        for(size_t i = n > 3 ? n - 3 : 0; i < n; ++i)
+            rv += std::ldexp(limbs_[i], 32 * int(i - (n > 3 ? n - 3 : 0)));
+        e = n > 3 ? 32 * int(n - 3) : 0;
+        return rv;
+    }
+
+    std::vector<uint32_t> limbs_; // least significant first, no leading zeros
+};
+
+
+// Convolution of two distributions over a number of mines, scaled so that
+// its largest entry is 1. Only ratios matter, and this keeps products of
+// many components within double's range.
+std::vector<double> convolve(const std::vector<double>& a, const std::vector<double>& b) {
+    std::vector<double> rv(a.size() + b.size() - 1);
+    for(size_t i = 0; i < a.size(); ++i)
+        if (a[i])
+            for(size_t j = 0; j < b.size(); ++j)
+                rv[i + j] += a[i] * b[j];
+
+    auto max = *std::max_element(rv.begin(), rv.end());
+    if (max > 0)
+        for(auto& v: rv)
+            v /= max;
+
+    return rv;
+}
+
+
+std::vector<BigUint> convolve(const std::vector<BigUint>& a, const std::vector<BigUint>& b) {
+    std::vector<BigUint> rv(a.size() + b.size() - 1);
+    for(size_t i = 0; i < a.size(); ++i)
+        if (!a[i].zero())
+            for(size_t j = 0; j < b.size(); ++j)
+                rv[i + j].add_product(a[i], b[j]);
+    return rv;
+}
+
+} // namespace
+
+
+void ProbabilityEngine::clear(size_t board_cols) {
+    ids_.clear(board_cols);
+    cells_.clear();
+    for(auto& v: cell_constraints_)
+        v.clear();
+    constraints_.clear();
+    components_.clear();
+    groups_.clear();
+    kept_cells_nr_ = 0;
+    ++round_;
+}
+
+
+bool ProbabilityEngine::group(uint64_t key, uint64_t version) {
+    auto& g = kept_[key];
+    I_ASSERT(g.round != round_, EX_LOG("group " << key << " started twice"));
+    g.round = round_;
+    if (g.computed and g.version == version) {
+        kept_cells_nr_ += g.cells_nr;
+        groups_.push_back(&g);
+        return false;
+    }
+
+    g.version = version;
+    g.computed = false;
+    g.cells_nr = 0;
+    g.components.clear();
+    groups_.push_back(&g);
+    return true;
+}
+
+
+uint32_t ProbabilityEngine::cell_id(Location l) {
+    if (ids_.emplace(l, cells_.size())) {
+        cells_.push_back(l);
+        if (cell_constraints_.size() < cells_.size())
+            cell_constraints_.resize(cells_.size());
+    }
+
+    return ids_.find(l);
+}
+
+
+void ProbabilityEngine::add(uint8_t mines_nr, const Location* cells, uint8_t nr) {
+    I_ASSERT(nr <= 8, EX_LOG("too many cells in a constraint: " << int(nr)));
+    if (!nr)
+        return;
+
+    I_ASSERT(!groups_.empty(), EX_LOG("constraint added outside of a group"));
+    Constraint c;
+    c.mines_nr = mines_nr;
+    c.nr = nr;
+    c.group = uint32_t(groups_.size() - 1);
+    auto id = uint32_t(constraints_.size());
+    for(uint8_t i = 0; i < nr; ++i) {
+        c.cells[i] = cell_id(cells[i]);
+        cell_constraints_[c.cells[i]].push_back(id);
+    }
+    constraints_.push_back(c);
+}
+
+
+void ProbabilityEngine::split() {
+    components_.clear();
+
+    // breadth-first order keeps constraints tight early during backtracking
+    std::vector<bool> seen_cells(cells_.size()), seen_constraints(constraints_.size());
+    for(uint32_t start = 0; start < cells_.size(); ++start) {
+        if (seen_cells[start])
+            continue;
+
+        components_.emplace_back();
+        auto& comp = components_.back();
+        seen_cells[start] = true;
+        comp.cells.push_back(start);
+        for(size_t i = 0; i < comp.cells.size(); ++i)
+            for(auto c: cell_constraints_[comp.cells[i]]) {
+                if (seen_constraints[c])
+                    continue;
+
+                seen_constraints[c] = true;
+                comp.constraints.push_back(c);
+                auto& k = constraints_[c];
+                for(uint8_t j = 0; j < k.nr; ++j)
+                    if (!seen_cells[k.cells[j]]) {
+                        seen_cells[k.cells[j]] = true;
+                        comp.cells.push_back(k.cells[j]);
+                    }
+            }
+
+        comp.group = constraints_[comp.constraints.front()].group;
+        for(auto cell: comp.cells)
+            comp.locations.push_back(cells_[cell]);
+    }
+
+    // small components first, so that a huge one only exhausts what's left
+    std::stable_sort(components_.begin(), components_.end(),
+                     [](const Component& a, const Component& b) {
+                         return a.cells.size() < b.cells.size();
+                     });
+}
+
+
+bool ProbabilityEngine::assign(uint32_t cell, int v) {
+    values_[cell] = v;
+    trail_.push_back(cell);
+
+    bool ok = true;
+    for(auto c: cell_constraints_[cell]) {
+        placed_[c] += v;
+        --pending_[c];
+        auto need = constraints_[c].mines_nr;
+        ok = ok and placed_[c] <= need and placed_[c] + pending_[c] >= need;
+    }
+
+    return ok;
+}
+
+
+bool ProbabilityEngine::propagate(size_t from) {
+    // cells of a constraint which has all of its mines, or needs all of the
+    // cells left, are forced
+    for(auto i = from; i < trail_.size(); ++i)
+        for(auto c: cell_constraints_[trail_[i]]) {
+            auto& k = constraints_[c];
+            if (!pending_[c])
+                continue;
+
+            int v;
+            if (placed_[c] == k.mines_nr)
+                v = 0;
+            else if (placed_[c] + pending_[c] == k.mines_nr)
+                v = 1;
+            else
+                continue;
+
+            for(uint8_t j = 0; j < k.nr; ++j)
+                if (values_[k.cells[j]] < 0 and !assign(k.cells[j], v))
+                    return false;
+        }
+
+    return true;
+}
+
+
+void ProbabilityEngine::undo(size_t mark) {
+    while(trail_.size() > mark) {
+        auto cell = trail_.back();
+        trail_.pop_back();
+        for(auto c: cell_constraints_[cell]) {
+            placed_[c] -= values_[cell];
+            ++pending_[c];
+        }
+        values_[cell] = -1;
+    }
+}
+
+
+bool ProbabilityEngine::descend(Component& comp, size_t i) {
+    if (++steps_ > budget_)
+        return false;
+
+    while(i < comp.cells.size() and values_[comp.cells[i]] >= 0)
+        ++i;
+
+    if (i == comp.cells.size()) {
+        steps_ += comp.cells.size();
+        size_t mines{};
+        for(auto cell: comp.cells)
+            mines += values_[cell];
+
+        comp.counts[mines] += 1;
+        auto& cc = comp.cell_counts[mines];
+        if (cc.empty())
+            cc.resize(comp.cells.size());
+        for(size_t j = 0; j < comp.cells.size(); ++j)
+            cc[j] += values_[comp.cells[j]];
+        return true;
+    }
+
+    for(int v = 0; v < 2; ++v) {
+        auto mark = trail_.size();
+        auto ok = assign(comp.cells[i], v) and propagate(mark);
+        steps_ += trail_.size() - mark;
+        auto in_budget = !ok or descend(comp, i + 1);
+        undo(mark);
+
+        if (!in_budget)
+            return false;
+    }
+
+    return true;
+}
+
+
+bool ProbabilityEngine::enumerate(Component& comp) {
+    for(auto c: comp.constraints) {
+        placed_[c] = 0;
+        pending_[c] = constraints_[c].nr;
+    }
+
+    comp.counts.assign(comp.cells.size() + 1, 0);
+    comp.cell_counts.assign(comp.cells.size() + 1, {});
+    trail_.clear();
+    if (!descend(comp, 0))
+        return false;
+
+    // drop impossible mine numbers from the tail
+    while(!comp.counts.empty() and !comp.counts.back())
+        comp.counts.pop_back();
+    comp.cell_counts.resize(comp.counts.size());
+    return true;
+}
+
+
+void ProbabilityEngine::estimate(Component& comp) {
+    // Start from average density of constraints a cell is in, then rescale
+    // cells of each constraint in turn to match its number of mines.
+    std::vector<double>& p = estimates_;
+    p.resize(cells_.size());
+    for(auto cell: comp.cells) {
+        p[cell] = 0;
+        for(auto c: cell_constraints_[cell])
+            p[cell] += double(constraints_[c].mines_nr) / constraints_[c].nr;
+        p[cell] /= cell_constraints_[cell].size();
+    }
+
+    for(int round = 0; round < kEstimateRounds; ++round)
+        for(auto c: comp.constraints) {
+            auto& k = constraints_[c];
+            double sum{};
+            for(uint8_t i = 0; i < k.nr; ++i)
+                sum += p[k.cells[i]];
+
+            for(uint8_t i = 0; i < k.nr; ++i) {
+                auto& v = p[k.cells[i]];
+                v = sum > 0 ? std::min(1., v * k.mines_nr / sum) : double(k.mines_nr) / k.nr;
+            }
+        }
+
+    comp.estimates.clear();
+    for(auto cell: comp.cells)
+        comp.estimates.push_back(p[cell]);
+}
+
+
+// Steps of building every "all components but one" distribution and
+// weighting the layouts of each component with them; "total" is the length
+// of the distribution of all components.
+size_t ProbabilityEngine::combine_cost(size_t& total) const {
+    auto n = active_.size();
+    std::vector<size_t> prefix_len(n + 1, 1), suffix_len(n + 1, 1);
+    for(size_t i = 0; i < n; ++i)
+        prefix_len[i + 1] = prefix_len[i] + active_[i]->counts.size() - 1;
+    for(size_t i = n; i-- > 0;)
+        suffix_len[i] = suffix_len[i + 1] + active_[i]->counts.size() - 1;
+
+    size_t rv{};
+    for(size_t i = 0; i < n; ++i)
+        rv += prefix_len[i] * suffix_len[i + 1]
+            + (prefix_len[i] + suffix_len[i + 1]) * active_[i]->counts.size();
+    total = prefix_len[n];
+    return rv;
+}
+
+
+// Exact: layout counts are integers, and so are C(U, M - K) over their
+// common factor, so each probability is a ratio of big integers, rounded
+// only when it's divided out.
+bool ProbabilityEngine::combine_exact(size_t mines_left, size_t unconstrained_nr, Result& result) {
+    auto n = active_.size();
+    size_t total;
+    auto steps = combine_cost(total);
+
+    // K frontier mines leave M - K for the U other cells
+    size_t k0 = mines_left > unconstrained_nr ? mines_left - unconstrained_nr : 0;
+    size_t k1 = std::min(total - 1, mines_left);
+    if (k0 > k1)
+        return false;
+
+    // the cost in limb products, from the sizes of the integers
+    double count_bits{};
+    for(auto comp: active_)
+        count_bits += std::log2(*std::max_element(comp->counts.begin(), comp->counts.end()) + 1);
+    double weight_bits = (k1 - k0) * std::log2(std::max(mines_left, unconstrained_nr) + 1.);
+    auto count_limbs = size_t(count_bits / 32) + 1, weight_limbs = size_t(weight_bits / 32) + 1;
+    auto cost = steps * count_limbs * std::max(count_limbs, weight_limbs) / kLimbOpsPerStep;
+    if (steps_ + cost > budget_)
+        return false;
+    steps_ += cost;
+
+    std::vector<std::vector<BigUint>> counts(n);
+    for(size_t i = 0; i < n; ++i)
+        for(auto c: active_[i]->counts)
+            counts[i].emplace_back(uint64_t(c));
+
+    std::vector<std::vector<BigUint>> prefix(n + 1), suffix(n + 1);
+    prefix[0] = suffix[n] = {BigUint{1}};
+    for(size_t i = 0; i < n; ++i)
+        prefix[i + 1] = convolve(prefix[i], counts[i]);
+    for(size_t i = n; i-- > 0;)
+        suffix[i] = convolve(suffix[i + 1], counts[i]);
+
+    // C(U, M - K) = U! / ((M - K)! (U - M + K)!), times (M - k0)! (U - M + k1)! / U!,
+    // is an integer: the product of M - K + 1..M - k0 and of U - M + K + 1..U - M + k1
+    std::vector<BigUint> weights(total), high(k1 - k0 + 1);
+    high[k1 - k0] = BigUint{1};
+    for(auto k = k1; k > k0; --k)
+        (high[k - 1 - k0] = high[k - k0]) *= unconstrained_nr - mines_left + k;
+    BigUint low{1};
+    for(auto k = k0; k <= k1; ++k) {
+        if (k > k0)
+            low *= mines_left - k + 1;
+        weights[k].add_product(low, high[k - k0]);
+    }
+
+    std::vector<BigUint> rest;
+    for(size_t i = 0; i < n; ++i) {
+        auto& comp = *active_[i];
+        auto others = convolve(prefix[i], suffix[i + 1]);
+
+        // weight of component's layouts with k mines, summed over the others
+        rest.assign(comp.counts.size(), {});
+        BigUint norm;
+        for(size_t k = 0; k < comp.counts.size(); ++k) {
+            for(size_t j = 0; j < others.size(); ++j)
+                rest[k].add_product(others[j], weights[k + j]);
+            norm.add_product(counts[i][k], rest[k]);
+        }
+        if (norm.zero())
+            return false;
+
+        for(size_t c = 0; c < comp.locations.size(); ++c) {
+            BigUint p;
+            for(size_t k = 0; k < comp.counts.size(); ++k)
+                if (!comp.cell_counts[k].empty())
+                    p.add_product(BigUint{uint64_t(comp.cell_counts[k][c])}, rest[k]);
+            result.cells[comp.locations[c]] = p.ratio(norm);
+        }
+    }
+
+    result.other = 0;
+    if (unconstrained_nr) {
+        BigUint norm, mines;
+        for(auto k = k0; k <= k1; ++k) {
+            norm.add_product(prefix[n][k], weights[k]);
+            auto w = weights[k];
+            w *= mines_left - k;
+            mines.add_product(prefix[n][k], w);
+        }
+        result.other = mines.ratio(norm) / unconstrained_nr;
+    }
+
+    return true;
+}
+
+
+// As combine_exact(), in doubles: the counts are scaled, and the weights are
+// taken in log space, which keeps them in range on any board, but rounds.
+bool ProbabilityEngine::combine_scaled(size_t mines_left, size_t unconstrained_nr, Result& result) {
+    auto n = active_.size();
+    size_t total;
+    auto cost = combine_cost(total);
+    if (steps_ + cost > budget_)
+        return false;
+    steps_ += cost;
+
+    std::vector<std::vector<double>> prefix(n + 1), suffix(n + 1);
+    prefix[0] = suffix[n] = {1.};
+    for(size_t i = 0; i < n; ++i)
+        prefix[i + 1] = convolve(prefix[i], active_[i]->counts);
+    for(size_t i = n; i-- > 0;)
+        suffix[i] = convolve(suffix[i + 1], active_[i]->counts);
+
+    // weight of K frontier mines: ways to place the rest, C(U, M - K), scaled
+    std::vector<double> weights(total);
+    double max_log = -INFINITY;
+    for(size_t k = 0; k < total; ++k)
+        if (k <= mines_left and mines_left - k <= unconstrained_nr)
+            max_log = std::max(max_log, log_choose(unconstrained_nr, mines_left - k));
+    if (max_log == -INFINITY)
+        return false;
+
+    for(size_t k = 0; k < total; ++k)
+        if (k <= mines_left and mines_left - k <= unconstrained_nr)
+            weights[k] = std::exp(log_choose(unconstrained_nr, mines_left - k) - max_log);
+
+    std::vector<double> rest;
+    for(size_t i = 0; i < n; ++i) {
+        auto& comp = *active_[i];
+        auto others = convolve(prefix[i], suffix[i + 1]);
+
+        // weight of component's layouts with k mines, summed over the others
+        rest.assign(comp.counts.size(), 0);
+        double norm{};
+        for(size_t k = 0; k < comp.counts.size(); ++k) {
+            for(size_t j = 0; j < others.size(); ++j)
+                rest[k] += others[j] * weights[k + j];
+            norm += comp.counts[k] * rest[k];
+        }
+        if (!norm)
+            return false;
+
+        for(size_t c = 0; c < comp.locations.size(); ++c) {
+            double p{};
+            for(size_t k = 0; k < comp.counts.size(); ++k)
+                if (!comp.cell_counts[k].empty())
+                    p += comp.cell_counts[k][c] * rest[k];
+            result.cells[comp.locations[c]] = p / norm;
+        }
+    }
+
+    result.other = 0;
+    if (unconstrained_nr) {
+        double norm{}, mines{};
+        for(size_t k = 0; k < total; ++k) {
+            auto w = prefix[n][k] * weights[k];
+            norm += w;
+            if (k <= mines_left)
+                mines += w * (mines_left - k);
+        }
+        result.other = mines / norm / unconstrained_nr;
+    }
+
+    return true;
+}
+
+
+void ProbabilityEngine::combine_approximate(double mines_left, size_t unconstrained_nr, Result& result) {
+    // Weighting a layout with k mines by lambda^k makes components independent;
+    // lambda is chosen so that the expected number of mines matches.
+    std::vector<double> scaled;
+    auto expected_in = [&](const Component& comp, double log_lambda, std::vector<double>& w) {
+        w.resize(comp.counts.size());
+        double max = -INFINITY;
+        for(size_t k = 0; k < w.size(); ++k) {
+            w[k] = comp.counts[k] > 0 ? std::log(comp.counts[k]) + k * log_lambda : -INFINITY;
+            max = std::max(max, w[k]);
+        }
+
+        double norm{}, rv{};
+        for(size_t k = 0; k < w.size(); ++k) {
+            w[k] = std::exp(w[k] - max);
+            norm += w[k];
+            rv += k * w[k];
+        }
+        for(auto& v: w)
+            v /= norm;
+        return rv / norm;
+    };
+
+    auto expected = [&](double log_lambda) {
+        double rv = unconstrained_nr / (1 + std::exp(-log_lambda));
+        for(auto comp: active_)
+            rv += expected_in(*comp, log_lambda, scaled);
+        return rv;
+    };
+
+    double lo = -50, hi = 50;
+    for(int i = 0; i < 60; ++i) {
+        auto mid = (lo + hi) / 2;
+        if (expected(mid) < mines_left)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    auto log_lambda = (lo + hi) / 2;
+
+    for(auto comp: active_) {
+        expected_in(*comp, log_lambda, scaled);
+        for(size_t c = 0; c < comp->locations.size(); ++c) {
+            double p{};
+            for(size_t k = 0; k < scaled.size(); ++k)
+                if (comp->counts[k] > 0 and !comp->cell_counts[k].empty())
+                    p += scaled[k] * comp->cell_counts[k][c] / comp->counts[k];
+            result.cells[comp->locations[c]] = p;
+        }
+    }
+
+    result.other = unconstrained_nr ? 1 / (1 + std::exp(-log_lambda)) : 0;
+}
+
+
+bool ProbabilityEngine::compute(size_t mines_left, size_t unconstrained_nr, Result& result) {
+    result.cells.clear();
+    result.other = 0;
+    result.exact = true;
+    steps_ = 0;
+
+    values_.assign(cells_.size(), -1);
+    placed_.assign(constraints_.size(), 0);
+    pending_.assign(constraints_.size(), 0);
+
+    // groups left out of this round are gone from the board
+    for(auto it = kept_.begin(); it != kept_.end();)
+        if (it->second.round != round_)
+            it = kept_.erase(it);
+        else
+            ++it;
+
+    // only groups added again need enumerating
+    split();
+    for(auto& comp: components_) {
+        comp.enumerated = enumerate(comp);
+        if (!comp.enumerated)
+            estimate(comp);
+        else if (comp.counts.empty())
+            return false; // contradicting constraints
+    }
+
+    for(auto& comp: components_) {
+        auto& g = *groups_[comp.group];
+        g.cells_nr += comp.cells.size();
+        g.components.push_back(std::move(comp));
+    }
+
+    // Estimated components are done with. The others are combined, small
+    // ones first, as split() has them.
+    double estimated_mines{};
+    result.cells.reserve(cells_nr());
+    active_.clear();
+    for(auto g: groups_) {
+        g->computed = true;
+        for(auto& comp: g->components) {
+            if (comp.enumerated) {
+                active_.push_back(&comp);
+                continue;
+            }
+
+            for(size_t c = 0; c < comp.locations.size(); ++c) {
+                result.cells[comp.locations[c]] = comp.estimates[c];
+                estimated_mines += comp.estimates[c];
+            }
+            result.exact = false;
+        }
+    }
+    std::stable_sort(active_.begin(), active_.end(),
+                     [](const Component* a, const Component* b) {
+                         return a->locations.size() < b->locations.size();
+                     });
+
+    // estimated components rule out the layout weights altogether
+    auto enumerated = result.exact;
+    if (enumerated and combine_exact(mines_left, unconstrained_nr, result))
+        return true;
+
+    result.exact = false;
+    if (!enumerated or !combine_scaled(mines_left, unconstrained_nr, result))
+        combine_approximate(std::max(0., mines_left - estimated_mines), unconstrained_nr, result);
+
+    return true;
+}
+
+} // namespace miner
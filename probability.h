@@ -0,0 +1,123 @@
+#pragma once
+
+#include "cell_map.h"
+
+namespace miner {
+
+//
+// Mine probabilities for unknown cells. Constraints "sum of these unknown
+// cells == N" are split into independent components; valid mine layouts of
+// each component are enumerated by backtracking and counted per number of
+// mines. A layout with K frontier mines in total leaves C(U, M - K) ways to
+// place the rest over U unconstrained cells, which gives its weight.
+//
+// Counts and weights are combined as big integers, so each probability is
+// rounded only at the end. Enumeration and combination are limited by a
+// budget of steps. If the big integers don't fit it, the same combination
+// runs in doubles with the weights in log space, which rounds along the way;
+// if even that doesn't fit, or a component couldn't be enumerated and got a
+// local estimate, components are weighted independently with a per-mine
+// factor matching the expected number of mines. Only the first is flagged
+// as exact.
+//
+// Constraints come in groups, e.g. the components of FrontierComponents:
+// layout counts and estimates of a group are kept until it is given a new
+// version, so a compute() after a few cells got resolved enumerates only what
+// changed.
+//
+class ProbabilityEngine {
+public:
+    static constexpr size_t kDefaultBudget = size_t(1) << 20;
+    static constexpr int kEstimateRounds = 32;
+
+    using ProbabilityMap = std::unordered_map<Location, double>;
+
+    struct Result {
+        ProbabilityMap cells; // constrained cells
+        double other{};       // any unconstrained cell
+        bool exact{};
+    };
+
+    explicit ProbabilityEngine(size_t budget = kDefaultBudget) : budget_{budget} {}
+
+    // Starts over with the constraints; cells are on a board this wide.
+    // Groups are kept for group().
+    void clear(size_t board_cols);
+    // Starts a group of the constraints add()ed until the next one, which
+    // share no cells with other groups. Returns false if the last compute()
+    // had the group with this version, in which case its constraints are not
+    // to be added again.
+    bool group(uint64_t key, uint64_t version);
+    void add(uint8_t mines_nr, const Location* cells, uint8_t nr);
+    size_t cells_nr() const { return cells_.size() + kept_cells_nr_; } // distinct constrained cells
+
+    // Computes probabilities given the number of mines left on the board and
+    // the number of unknown cells no constraint covers. Returns false if
+    // constraints admit no layout.
+    bool compute(size_t mines_left, size_t unconstrained_nr, Result&);
+
+private:
+    struct Constraint {
+        int mines_nr{};
+        uint8_t nr{};
+        uint32_t group{}; // index into groups_
+        std::array<uint32_t, 8> cells;
+    };
+
+    // Per component layout counts: counts[k] layouts with k mines, of which
+    // cell_counts[k][i] have a mine at locations[i]. Without them, estimates[i]
+    // is the probability of a mine there.
+    struct Component {
+        std::vector<uint32_t> cells;       // ids, by the compute() which split it
+        std::vector<uint32_t> constraints;
+        std::vector<Location> locations;
+        std::vector<double> counts;
+        std::vector<std::vector<double>> cell_counts;
+        std::vector<double> estimates;
+        uint32_t group{};
+        bool enumerated{};
+    };
+
+    struct Group {
+        uint64_t version{};
+        size_t round{};     // of the last clear() which it was a part of
+        bool computed{};    // components are complete
+        size_t cells_nr{};
+        std::vector<Component> components;
+    };
+
+    uint32_t cell_id(Location);
+    void split();
+    bool enumerate(Component&);
+    bool assign(uint32_t cell, int v);
+    bool propagate(size_t from);
+    void undo(size_t mark);
+    bool descend(Component&, size_t i);
+    void estimate(Component&);
+    size_t combine_cost(size_t& total) const;
+    bool combine_exact(size_t mines_left, size_t unconstrained_nr, Result&);
+    bool combine_scaled(size_t mines_left, size_t unconstrained_nr, Result&);
+    void combine_approximate(double mines_left, size_t unconstrained_nr, Result&);
+
+    size_t budget_;
+    size_t steps_{}; // spent out of budget_ by the current compute()
+    CellMap<uint32_t> ids_;
+    std::vector<Location> cells_;
+    std::vector<std::vector<uint32_t>> cell_constraints_; // constraints by cell id
+    std::vector<Constraint> constraints_;
+    std::vector<Component> components_; // split by the current compute()
+    std::unordered_map<uint64_t, Group> kept_;
+    std::vector<Group*> groups_;        // started since clear(), in order
+    std::vector<const Component*> active_; // enumerated ones of groups_
+    size_t round_{};
+    size_t kept_cells_nr_{};            // in groups_ which weren't added again
+
+    // backtracking state, by cell/constraint id
+    std::vector<int8_t> values_; // -1 if not assigned
+    std::vector<uint32_t> trail_; // assigned cells, in order
+    std::vector<int> placed_;   // mines placed into a constraint so far
+    std::vector<int> pending_;  // its cells not assigned yet
+    std::vector<double> estimates_;
+};
+
+} // namespace miner
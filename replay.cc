@@ -0,0 +1,311 @@
+/*  Simple mines game with solver.
+    Copyright (C) 2015 Igor Shevchenko
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//
+// Replays a game recorded by SolverTrace (miner --trace, miner_batch
+// --trace) with a solver, for profiling it on exactly the same POIs.
+//
+// Usage: miner_replay TRACE [--solver NAME] [--pois FILE]
+//
+// The field is regenerated from the trace's seed, the player's moves are
+// made in their recorded order, and each recorded POI is solved on this
+// thread when the trace says it was started. The trace's backends are used,
+// switching where the game did, unless --solver names one for the whole
+// game. Recorded and replayed solve times, LP (or SAT)
+// solves and deductions are then compared, as is the final board with the
+// one the recorded deductions give. --pois writes the per-POI comparison as
+// CSV.
+//
+// POIs are replayed one at a time, so a trace of a parallel solver replays
+// in the order in which its workers happened to start them.
+//
+
+#include <chrono>
+
+#include "board.h"
+#include "solver_registry.h"
+
+namespace miner {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct ReplayConfig {
+    std::string trace;
+    const SolverRegistry::Backend* backend{};
+    std::string pois;
+};
+
+struct PoiTimes {
+    Location poi;
+    uint64_t recorded_ns{}, replayed_ns{};
+    uint64_t recorded_lp{}, replayed_lp{};
+    bool done{}; // matched with its kPoiDone record
+};
+
+struct Totals {
+    size_t moves{};
+    size_t pois{};
+    size_t queued{};   // addPoi() calls
+    size_t switches{}; // of backend
+    uint64_t recorded_ns{}, replayed_ns{};
+    uint64_t recorded_lp{}, replayed_lp{};
+    size_t recorded_deductions{}, replayed_deductions{};
+    size_t differing_cells{};
+    bool lost{};
+};
+
+
+void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s TRACE [--solver NAME] [--pois FILE]\n"
+            "solvers: %s\n", argv0, SolverRegistry::names().data());
+    exit(2);
+}
+
+
+ReplayConfig parse_args(int argc, char** argv) {
+    ReplayConfig rv;
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--")) {
+            if (!rv.trace.empty())
+                usage(argv[0]);
+            rv.trace = arg;
+            continue;
+        }
+
+        if (i + 1 == argc)
+            usage(argv[0]);
+        const char* v = argv[++i];
+        if (arg == "--solver") {
+            rv.backend = SolverRegistry::find(v);
+            if (!rv.backend)
+                usage(argv[0]);
+        }
+        else if (arg == "--pois")
+            rv.pois = v;
+        else
+            usage(argv[0]);
+    }
+
+    if (rv.trace.empty())
+        usage(argv[0]);
+    return rv;
+}
+
+
+// Opened cells open their zero regions, as the game and the solver do.
+void open(GameBoard& board, Location l) {
+    if (board.at(l) != GameBoard::CellInfo::Unknown)
+        return;
+    board.uncovered_safe(l, board.field()->nearby_mines_nr(l));
+    if (board.at(l) == GameBoard::CellInfo::N0) {
+        std::vector<Location> border;
+        board.open_zeros(l, border);
+    }
+}
+
+
+void apply_move(GameBoard& board, const SolverTrace::Record& r) {
+    auto l = r.location;
+    switch(r.event) {
+    case SolverTrace::Event::kOpen:
+    case SolverTrace::Event::kSafe:
+        open(board, l);
+        break;
+    case SolverTrace::Event::kExplode:
+        board.mark_exploded(l);
+        board.set_game_lost();
+        break;
+    case SolverTrace::Event::kMark:
+    case SolverTrace::Event::kMine:
+        if (board.at(l) == GameBoard::CellInfo::Unknown)
+            board.mark_mine(l, true);
+        break;
+    case SolverTrace::Event::kUnmark:
+        if (board.at(l) == GameBoard::CellInfo::MarkedMine)
+            board.mark_mine(l, false);
+        break;
+    default:
+        break;
+    }
+}
+
+
+bool is_move(SolverTrace::Event e) {
+    return e == SolverTrace::Event::kOpen or e == SolverTrace::Event::kExplode
+        or e == SolverTrace::Event::kMark or e == SolverTrace::Event::kUnmark;
+}
+
+
+Totals replay(SolverTrace::Reader& reader, const SolverRegistry::Backend& backend,
+              bool follow_switches, std::vector<PoiTimes>& pois) {
+    auto& h = reader.header();
+    auto field = std::make_shared<Field>();
+    if (h.lazy)
+        field->gen_lazy(h.rows, h.cols, h.mines_nr, h.seed);
+    else
+        field->gen_random(h.rows, h.cols, h.mines_nr, h.seed);
+
+    // the replayed game, and the one the trace's deductions make
+    auto board = std::make_shared<GameBoard>();
+    board->set_field(field);
+    GameBoard expected;
+    expected.set_field(field);
+
+    size_t deductions{};
+    auto solver = backend.create(board);
+    solver->setResultHandler([](Solver::FeedbackState, Location, size_t){});
+
+    Totals rv;
+    std::unordered_multimap<Location, size_t> pending; // of pois, by location
+    SolverTrace::Record r;
+    while(reader.next(r)) {
+        if (is_move(r.event)) {
+            ++rv.moves;
+            apply_move(*board, r);
+            apply_move(expected, r);
+            continue;
+        }
+
+        switch(r.event) {
+        case SolverTrace::Event::kPoi: {
+            PoiTimes p;
+            p.poi = r.location;
+            auto before = board->uncovered_nr() + board->mines_marked();
+            auto lp_solves = solver->lpSolves();
+            auto t0 = Clock::now();
+            if (!solver->solvePoi(r.location))
+                rv.lost = true;
+            p.replayed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+            p.replayed_lp = solver->lpSolves() - lp_solves;
+            deductions += board->uncovered_nr() + board->mines_marked() - before;
+            pending.emplace(r.location, pois.size());
+            pois.push_back(p);
+            break;
+        }
+        case SolverTrace::Event::kSafe:
+        case SolverTrace::Event::kMine: {
+            // with the zero regions they opened
+            auto before = expected.uncovered_nr() + expected.mines_marked();
+            apply_move(expected, r);
+            rv.recorded_deductions += expected.uncovered_nr() + expected.mines_marked() - before;
+            break;
+        }
+        case SolverTrace::Event::kAddPoi:
+            ++rv.queued;
+            break;
+        case SolverTrace::Event::kBackend: {
+            ++rv.switches;
+            if (!follow_switches)
+                break;
+            auto b = SolverRegistry::find(r.backend);
+            I_ASSERT(b, EX_LOG("trace switches to solver " << r.backend << ", which isn't compiled in"));
+            solver = b->create(board);
+            solver->setResultHandler([](Solver::FeedbackState, Location, size_t){});
+            break;
+        }
+        case SolverTrace::Event::kPoiDone: {
+            auto it = pending.find(r.location);
+            if (it == pending.end())
+                break;
+            auto& p = pois[it->second];
+            p.recorded_ns = r.ns;
+            p.recorded_lp = r.lp_solves;
+            p.done = true;
+            pending.erase(it);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    rv.pois = pois.size();
+    rv.replayed_deductions = deductions;
+    for(auto& p: pois) {
+        rv.recorded_ns += p.recorded_ns;
+        rv.replayed_ns += p.replayed_ns;
+        rv.recorded_lp += p.recorded_lp;
+        rv.replayed_lp += p.replayed_lp;
+    }
+    for(size_t row = 0; row < board->rows(); ++row)
+        for(size_t col = 0; col < board->cols(); ++col)
+            rv.differing_cells += board->at({row, col}) != expected.at({row, col});
+    return rv;
+}
+
+
+void write_pois(FILE* f, const std::vector<PoiTimes>& pois) {
+    fprintf(f, "row,col,recorded_ns,replayed_ns,recorded_lp,replayed_lp\n");
+    for(auto& p: pois) {
+        if (p.done)
+            fprintf(f, "%u,%u,%lu,%lu,%lu,%lu\n", p.poi.row, p.poi.col,
+                    p.recorded_ns, p.replayed_ns, p.recorded_lp, p.replayed_lp);
+        else
+            fprintf(f, "%u,%u,,%lu,,%lu\n", p.poi.row, p.poi.col, p.replayed_ns, p.replayed_lp);
+    }
+}
+
+} // namespace
+} // namespace miner
+
+
+int main(int argc, char** argv) {
+    auto cfg = miner::parse_args(argc, argv);
+
+    try {
+        miner::SolverTrace::Reader reader{cfg.trace};
+        auto& h = reader.header();
+        auto backend = cfg.backend ? cfg.backend : miner::SolverRegistry::find(h.backend);
+        if (!backend) {
+            fprintf(stderr, "%s: trace's solver %s isn't compiled in, pick one with --solver\n",
+                    cfg.trace.data(), h.backend.data());
+            return 2;
+        }
+
+        std::vector<miner::PoiTimes> pois;
+        auto t = miner::replay(reader, *backend, !cfg.backend, pois);
+
+        printf("field:       %zux%zu, %zu mines, seed %ld%s\n",
+               h.rows, h.cols, h.mines_nr, h.seed, h.lazy ? ", lazy" : "");
+        printf("solver:      %s (recorded with %s)\n", backend->name, h.backend.data());
+        printf("moves:       %zu\n", t.moves);
+        printf("pois:        %zu solved, %zu queued\n", t.pois, t.queued);
+        if (t.switches)
+            printf("switches:    %zu of solver%s\n", t.switches, cfg.backend ? ", ignored for --solver" : "");
+        printf("solve ms:    recorded %.3f, replayed %.3f\n", t.recorded_ns / 1e6, t.replayed_ns / 1e6);
+        printf("lp solves:   recorded %lu, replayed %lu\n", t.recorded_lp, t.replayed_lp);
+        printf("deductions:  recorded %zu, replayed %zu\n", t.recorded_deductions, t.replayed_deductions);
+        printf("differing:   %zu cells%s\n", t.differing_cells, t.lost ? ", solver lost the game" : "");
+
+        if (!cfg.pois.empty()) {
+            FILE* f = fopen(cfg.pois.data(), "w");
+            if (!f) {
+                perror(cfg.pois.data());
+                return 1;
+            }
+            miner::write_pois(f, pois);
+            fclose(f);
+        }
+        return t.differing_cells ? 3 : 0;
+
+    } catch(const i::exception&) {
+        return 1; // already reported by I_ASSERT()
+    }
+}
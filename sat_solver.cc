@@ -0,0 +1,205 @@
+#include "sat_solver.h"
+
+namespace miner {
+
+bool SatSolver::doPoi(miner::Location poi) {
+    if (board_->is_uncovered(poi)) {
+	auto pois = getNeighborhoodInfo(poi);
+	if (!pois.nr)
+	    return true;
+    }
+    
+    // common patterns don't need a search
+    if (!reduce(poi))
+	return false;
+    
+    if (board_->is_uncovered(poi)) {
+	auto pois = getNeighborhoodInfo(poi);
+	if (!pois.nr)
+	    return true;
+    }
+    
+    // one instance per frontier component
+    collectComponents(poi, components_);
+    for(auto& constraints: components_)
+	if (!solveComponent(poi, constraints))
+	    return false;
+    
+    // near the end, the number of mines left may resolve what components can't
+    if (!solveGlobal(poi))
+	return false;
+    
+    return true;
+}
+
+
+void SatSolver::build() {
+    cells_.clear();
+    vars_.clear(board_->cols());
+    for(auto& info: infos_)
+	for(uint8_t i = 0; i < info.nr; ++i)
+	    if (vars_.emplace(info.coveredUnmarkedLocations[i], cells_.size()))
+		cells_.push_back(info.coveredUnmarkedLocations[i]);
+    
+    sat_.reset(cells_.size());
+    for(auto& info: infos_) {
+	if (!info.nr)
+	    continue;
+	
+	constraint_.clear();
+	for(uint8_t i = 0; i < info.nr; ++i)
+	    constraint_.push_back(vars_.find(info.coveredUnmarkedLocations[i]));
+	sat_.add(constraint_.data(), constraint_.size(), info.mines_nr, info.mines_nr);
+    }
+}
+
+
+CardinalitySat::Result SatSolver::solve(const CardinalitySat::Lit* assumptions, size_t nr) {
+    auto rv = sat_.solve(assumptions, nr);
+    ++stats_.sat_solves;
+    stats_.conflicts = sat_.stats().conflicts;
+    stats_.decisions = sat_.stats().decisions;
+    if (rv == CardinalitySat::Result::kUnknown)
+	++stats_.probes_unknown;
+    else if (rv == CardinalitySat::Result::kSat)
+	witness();
+    return rv;
+}
+
+
+bool SatSolver::solveComponent(Location poi, const std::vector<Location>& constraints) {
+    infos_.clear();
+    for(auto& l: constraints)
+	infos_.push_back(board_->is_uncovered(l) ? getNeighborhoodInfo(l) : NeighborhoodInfo{});
+    
+    build();
+    if (cells_.empty())
+	return true;
+    
+    return probe(poi);
+}
+
+
+void SatSolver::witness() {
+    size_t mined{};
+    for(CardinalitySat::Var v = 0; v < cells_.size(); ++v) {
+	auto x = sat_.value(v);
+	witnesses_[v] |= x ? kSeenMined : kSeenSafe;
+	mined += x;
+    }
+    minMined_ = std::min(minMined_, mined);
+    maxMined_ = std::max(maxMined_, mined);
+}
+
+
+bool SatSolver::probe(Location poi) {
+    // Every model is a witness: a cell seen safe can't be forced mined, one
+    // seen mined can't be forced safe, so assuming those is pointless.
+    witnesses_.assign(cells_.size(), 0);
+    minMined_ = cells_.size();
+    maxMined_ = 0;
+    auto rv = solve(nullptr, 0);
+    if (rv == CardinalitySat::Result::kUnsat) {
+	errlog << "ERROR: no solution of constraints around " << poi;
+	board_->dump_region(poi, 3);
+	return true;
+    }
+    if (rv != CardinalitySat::Result::kSat)
+	return true;
+    
+    bool ok = true;
+    for(CardinalitySat::Var v = 0; v < cells_.size() and ok; ++v) {
+	auto& seen = witnesses_[v];
+	int mined = -1;
+	if (seen & kSeenMined) {
+	    ++stats_.probes_skipped;
+	} else {
+	    auto a = CardinalitySat::lit(v, true);
+	    if (solve(&a, 1) == CardinalitySat::Result::kUnsat)
+		mined = 0; // can't have a mine here
+	}
+	
+	if (mined < 0) {
+	    if (seen & kSeenSafe) {
+		++stats_.probes_skipped;
+	    } else {
+		auto a = CardinalitySat::lit(v, false);
+		if (solve(&a, 1) == CardinalitySat::Result::kUnsat)
+		    mined = 1; // must have a mine here
+	    }
+	}
+	
+	if (mined < 0)
+	    continue;
+	
+	// facts speed up the probes which follow, as do clauses learned so far
+	ok = applyDeduction(poi, cells_[v], mined);
+	if (ok and !sat_.fix(v, mined)) {
+	    errlog << "ERROR: no solution with " << cells_[v] << " fixed, poi=" << poi;
+	    break;
+	}
+    }
+    
+    return ok;
+}
+
+
+void SatSolver::boundMined(size_t lo, size_t hi) {
+    constraint_.clear();
+    for(CardinalitySat::Var v = 0; v < cells_.size(); ++v)
+	constraint_.push_back(v);
+    sat_.add(constraint_.data(), constraint_.size(), uint32_t(lo), uint32_t(hi));
+}
+
+
+bool SatSolver::noneMined(size_t lo, size_t hi) {
+    if (lo > hi)
+	return true;
+    build();
+    boundMined(lo, hi);
+    return solve(nullptr, 0) == CardinalitySat::Result::kUnsat;
+}
+
+
+bool SatSolver::probeGlobal(Location poi, GlobalModel& m) {
+    //
+    // every frontier constraint, plus one on the number of mines in the
+    // frontier: the mines left minus what the rest may take
+    //
+    auto probes_unknown = stats_.probes_unknown;
+    infos_.assign(m.infos.begin(), m.infos.end());
+    build();
+    boundMined(m.mines_left > m.rest_nr ? m.mines_left - m.rest_nr : 0, m.mines_left);
+    auto rv = probe(poi);
+    if (stats_.probes_unknown != probes_unknown)
+	m.exhaustive = false;
+    return rv;
+}
+
+
+size_t SatSolver::globalRestBound(GlobalModel& m, bool maximize) {
+    //
+    // the rest can't take any mine (or safe cell) when no solution leaves
+    // it one; witnesses of the probes mostly show one does
+    //
+    if (minMined_ > maxMined_)
+	return maximize ? m.rest_nr : 0;
+    
+    auto probes_unknown = stats_.probes_unknown;
+    auto mines_left = m.mines_left;
+    size_t rv = maximize ? m.rest_nr : 0;
+    if (maximize) {
+	size_t lo = mines_left > m.rest_nr ? mines_left - m.rest_nr : 0;
+	if (minMined_ >= mines_left and (!mines_left or noneMined(lo, mines_left - 1)))
+	    rv = 0;
+    } else {
+	if (maxMined_ + m.rest_nr <= mines_left and noneMined(mines_left + 1 - m.rest_nr, mines_left))
+	    rv = m.rest_nr;
+    }
+    
+    if (stats_.probes_unknown != probes_unknown)
+	m.exhaustive = false;
+    return rv;
+}
+
+} // namespace miner
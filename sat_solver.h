@@ -0,0 +1,65 @@
+#pragma once
+
+#include "cell_map.h"
+#include "solver.h"
+#include "cardinality_sat.h"
+
+namespace miner {
+
+//
+// Exact solver on CardinalitySat: number cells become cardinality
+// constraints over their unknown neighbors, and a cell is resolved when
+// assuming the opposite value is unsatisfiable. Unlike an LP relaxation,
+// this resolves every cell the constraints of a component force. Near the
+// end of the game, the number of mines left bounds the whole frontier.
+//
+class SatSolver : public Solver {
+public:
+    using Solver::Solver;
+    
+    struct Stats {
+	size_t sat_solves{};
+	size_t conflicts{};
+	size_t decisions{};
+	size_t probes_skipped{}; // solves avoided thanks to witnesses
+	size_t probes_unknown{}; // solves which ran out of conflict budget
+    };
+    
+    const Stats& stats() const { return stats_; }
+    // every probe and witness solve, as LP backends count their LPs
+    size_t lpSolves() const override { return stats_.sat_solves; }
+    
+protected:
+    enum : uint8_t {
+	kSeenSafe = 1,
+	kSeenMined = 2,
+    };
+    
+    bool doPoi(miner::Location) override;
+    // Sets sat_ up with a variable per cell and a constraint per number of
+    // infos_.
+    void build();
+    bool solveComponent(Location poi, const std::vector<Location>& constraints);
+    bool probeGlobal(Location poi, GlobalModel&) override;
+    size_t globalRestBound(GlobalModel&, bool maximize) override;
+    // adds a constraint on the number of mines in cells_
+    void boundMined(size_t lo, size_t hi);
+    // whether no solution has between lo and hi mines in cells_
+    bool noneMined(size_t lo, size_t hi);
+    // finds cells_ which are forced to be safe or mined
+    bool probe(Location poi);
+    CardinalitySat::Result solve(const CardinalitySat::Lit* assumptions, size_t nr);
+    void witness(); // records values of cells_ in witnesses_
+    
+    CardinalitySat sat_;
+    std::vector<std::vector<Location>> components_;
+    std::vector<NeighborhoodInfo> infos_;
+    std::vector<Location> cells_;                  // variable -> cell
+    CellMap<uint32_t> vars_;                                 // cell -> variable
+    std::vector<CardinalitySat::Var> constraint_;
+    std::vector<uint8_t> witnesses_;               // kSeen* values seen per variable
+    size_t minMined_{}, maxMined_{};               // mines in cells_ over witnesses
+    Stats stats_;
+};
+
+} // namespace miner
@@ -0,0 +1,171 @@
+#include "simplex_solver.h"
+
+namespace miner {
+
+bool SimplexSolver::doPoi(miner::Location poi) {
+    if (board_->is_uncovered(poi)) {
+	auto pois = getNeighborhoodInfo(poi);
+	if (!pois.nr)
+	    return true;
+    }
+    
+    // common patterns don't need an LP
+    if (!reduce(poi))
+	return false;
+    
+    if (board_->is_uncovered(poi)) {
+	auto pois = getNeighborhoodInfo(poi);
+	if (!pois.nr)
+	    return true;
+    }
+    
+    // one LP per frontier component
+    collectComponents(poi, components_);
+    for(auto& constraints: components_)
+	if (!solveComponent(poi, constraints))
+	    return false;
+    
+    // near the end, the number of mines left may resolve what components can't
+    if (!solveGlobal(poi))
+	return false;
+    
+    return true;
+}
+
+
+size_t SimplexSolver::build(size_t extra_rows, size_t extra_cols) {
+    cells_.clear();
+    columns_.clear(board_->cols());
+    size_t rows{};
+    for(auto& info: infos_) {
+	if (!info.nr)
+	    continue;
+	
+	++rows;
+	for(uint8_t i = 0; i < info.nr; ++i)
+	    if (columns_.emplace(info.coveredUnmarkedLocations[i], cells_.size()))
+		cells_.push_back(info.coveredUnmarkedLocations[i]);
+    }
+    
+    lp_.reset(rows + extra_rows, cells_.size() + extra_cols);
+    size_t row{};
+    for(auto& info: infos_) {
+	if (!info.nr)
+	    continue;
+	
+	for(uint8_t i = 0; i < info.nr; ++i)
+	    lp_.set(row, columns_.find(info.coveredUnmarkedLocations[i]), 1);
+	lp_.set_rhs(row++, info.mines_nr);
+    }
+    
+    return rows;
+}
+
+
+bool SimplexSolver::solveComponent(Location poi, const std::vector<Location>& constraints) {
+    infos_.clear();
+    for(auto& l: constraints)
+	infos_.push_back(board_->is_uncovered(l) ? getNeighborhoodInfo(l) : NeighborhoodInfo{});
+    
+    build(0, 0);
+    if (cells_.empty())
+	return true;
+    
+    return probe(poi);
+}
+
+
+void SimplexSolver::witness() {
+    for(size_t c = 0; c < cells_.size(); ++c) {
+	auto x = lp_.value(c);
+	witnesses_[c] |= (x < kEpsilon ? kSeenSafe : 0) | (x > 1 - kEpsilon ? kSeenMined : 0);
+    }
+}
+
+
+bool SimplexSolver::probe(Location poi) {
+    // Every solution is a witness: a column seen at 0 can't be a mine, one
+    // seen at 1 can't be safe, so probing for those is pointless.
+    auto iterations = lp_.iterations();
+    witnesses_.assign(cells_.size(), 0);
+    ++stats_.lp_solves;
+    if (!lp_.feasible()) {
+	errlog << "ERROR: no feasible point of constraints around " << poi;
+	board_->dump_region(poi, 3);
+	return true;
+    }
+    witness();
+    
+    bool rv = true;
+    for(size_t c = 0; c < cells_.size() and rv; ++c) {
+	auto& seen = witnesses_[c];
+	if (seen == (kSeenSafe | kSeenMined)) {
+	    stats_.probes_skipped += 2;
+	    continue;
+	}
+	
+	auto hi = 1.;
+	if (seen & kSeenMined) {
+	    ++stats_.probes_skipped;
+	} else {
+	    hi = lp_.optimize(c, true);
+	    ++stats_.lp_solves;
+	    witness();
+	}
+	
+	int mined = -1;
+	if (hi <= 1 - kEpsilon) {
+	    mined = 0; // can't have a mine here
+	} else if (seen & kSeenSafe) {
+	    ++stats_.probes_skipped;
+	} else {
+	    auto lo = lp_.optimize(c, false);
+	    ++stats_.lp_solves;
+	    witness();
+	    if (lo >= kEpsilon)
+		mined = 1; // must have a mine here
+	}
+	
+	if (mined < 0)
+	    continue;
+	
+	rv = applyDeduction(poi, cells_[c], mined);
+	if (rv and !lp_.fix(c, mined)) {
+	    errlog << "ERROR: no feasible point with " << cells_[c] << " fixed, poi=" << poi;
+	    break;
+	}
+	witness();
+    }
+    
+    stats_.simplex_iterations += lp_.iterations() - iterations;
+    return rv;
+}
+
+
+bool SimplexSolver::probeGlobal(Location poi, GlobalModel& m) {
+    //
+    // every frontier constraint, plus a row summing all unknown cells up to
+    // the number of mines left; the rest is a single column
+    //
+    infos_.assign(m.infos.begin(), m.infos.end());
+    auto total = build(1, 1);
+    size_t rest = cells_.size();
+    for(size_t c = 0; c <= rest; ++c)
+	lp_.set(total, c, 1);
+    lp_.set_rhs(total, m.mines_left);
+    lp_.set_bounds(rest, 0, m.rest_nr);
+    
+    return probe(poi);
+}
+
+
+size_t SimplexSolver::globalRestBound(GlobalModel& m, bool maximize) {
+    if (!lp_.has_feasible_basis())
+	return maximize ? m.rest_nr : 0;
+    
+    auto v = lp_.optimize(cells_.size(), maximize);
+    ++stats_.lp_solves;
+    return maximize ? size_t(std::floor(v + kEpsilon)) : size_t(std::ceil(v - kEpsilon));
+}
+
+} // namespace miner
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "cell_map.h"
+#include "solver.h"
+#include "bounded_simplex.h"
+
+namespace miner {
+
+//
+// LP-based solver on the built-in BoundedSimplex, with no LP library
+// needed. Makes the same deductions as GlpkSolver: one LP per frontier
+// component, and near the end of the game, one over the whole frontier with
+// the number of mines left.
+//
+class SimplexSolver : public Solver {
+public:
+    static constexpr double kEpsilon = 1e-6;
+    using Solver::Solver;
+    
+    struct Stats {
+	size_t lp_solves{};
+	size_t simplex_iterations{};
+	size_t probes_skipped{}; // max/min solves avoided thanks to witnesses
+    };
+    
+    const Stats& stats() const { return stats_; }
+    size_t lpSolves() const override { return stats_.lp_solves; }
+    
+protected:
+    enum : uint8_t {
+	kSeenSafe = 1,
+	kSeenMined = 2,
+    };
+    
+    bool doPoi(miner::Location) override;
+    // Sets lp_ up with a row per constraint of infos_ over a column per cell,
+    // followed by extra rows and columns for the caller to fill in. Returns
+    // the number of constraint rows.
+    size_t build(size_t extra_rows, size_t extra_cols);
+    bool solveComponent(Location poi, const std::vector<Location>& constraints);
+    bool probeGlobal(Location poi, GlobalModel&) override;
+    size_t globalRestBound(GlobalModel&, bool maximize) override;
+    // finds cells_ which are forced to be safe or mined
+    bool probe(Location poi);
+    void witness(); // records values of cells_ in witnesses_
+    
+    BoundedSimplex lp_;
+    std::vector<std::vector<Location>> components_;
+    std::vector<NeighborhoodInfo> infos_;
+    std::vector<Location> cells_;                  // LP column -> cell
+    CellMap<uint32_t> columns_;                    // cell -> LP column
+    std::vector<uint8_t> witnesses_;               // kSeen* values seen per column
+    Stats stats_;
+};
+
+} // namespace miner
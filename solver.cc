@@ -37,9 +37,13 @@ bool Solver::okToRun() {
 	    break;
 	}
 	    
-	case RunState::kSuspending:
-	    state_ = RunState::kSuspended;
+	case RunState::kSuspending: {
+	    std::lock_guard<std::mutex> lck{mtx_};
+	    if (state_ == RunState::kSuspending)
+		state_ = RunState::kSuspended;
+	    cond_.notify_all();
 	    break;
+	}
 	    
 	case RunState::kRunning:
 	    return true;
@@ -55,7 +59,21 @@ void Solver::suspend() {
     I_ASSERT(state_ != RunState::kExit, EX_LOG("state == kExit"));
     std::lock_guard<std::mutex> lck(mtx_);
     state_ = RunState::kSuspending;
-    cond_.notify_one();
+    cond_.notify_all();
+}
+
+
+bool Solver::suspendAndWait() {
+    std::unique_lock<std::mutex> lck(mtx_);
+    bool was_running = state_ == RunState::kRunning;
+    if (was_running) {
+	state_ = RunState::kSuspending;
+	cond_.notify_all();
+    }
+    
+    cond_.wait(lck, [&] {
+	    return state_ != RunState::kRunning and state_ != RunState::kSuspending; });
+    return was_running;
 }
 
 
@@ -63,20 +81,69 @@ void Solver::resume() {
     I_ASSERT(state_ != RunState::kExit, EX_LOG("state == kExit"));
     std::lock_guard<std::mutex> lck(mtx_);
     state_ = RunState::kRunning;
-    cond_.notify_one();
+    cond_.notify_all();
 }
 
 
 void Solver::stop() {
     std::lock_guard<std::mutex> lck(mtx_);
     state_ = RunState::kExit;
-    cond_.notify_one();
+    cond_.notify_all();
+}
+
+
+void Solver::setState(RunState s) {
+    std::lock_guard<std::mutex> lck(mtx_);
+    state_ = s;
+    cond_.notify_all();
 }
 
 
 void Solver::addPoi(Location l) {
+    if (parent_)
+	return parent_->addPoi(l);
+    
+    if (trace_)
+	trace_->record(SolverTrace::Event::kAddPoi, l);
+    std::lock_guard<std::mutex> lock{queue_mtx_};
+    if (!poi_.sized())
+	poi_.reset(board_->rows(), board_->cols());
+    poi_.push(l);
+}
+
+
+PoiScheduler::Stats Solver::poiStats() const {
     std::lock_guard<std::mutex> lock{queue_mtx_};
-    poi_.push_back(l);
+    return poi_.stats();
+}
+
+
+void Solver::setWindow(const Window& w) {
+    if (windowed_ and w.row0 == window_.row0 and w.col0 == window_.col0
+        and w.row1 == window_.row1 and w.col1 == window_.col1)
+	return;
+    
+    // Components reaching outside of the new window are cut down by
+    // collectComponents() when it gets to them, but ones it never gets to
+    // again would pile up.
+    if (frontier_.nodes_nr() > kFrontierWindows * (w.row1 - w.row0) * (w.col1 - w.col0))
+	frontier_ = FrontierComponents{};
+    
+    window_ = w;
+    windowed_ = true;
+    windowChanged();
+}
+
+
+bool Solver::inWindow(Location l) const {
+    if (!windowed_)
+	return true;
+    
+    // neighborhood must fit in, unless it is cut by the board's edge anyway
+    return (l.row > window_.row0 or !window_.row0)
+        and (l.row + 1 < window_.row1 or window_.row1 == board_->rows())
+        and (l.col > window_.col0 or !window_.col0)
+        and (l.col + 1 < window_.col1 or window_.col1 == board_->cols());
 }
 
 
@@ -129,25 +196,384 @@ Solver::NeighborhoodInfo Solver::getNeighborhoodInfo(Location l) const {
 }
 
 
+bool Solver::reduce(Location poi) {
+    reducer_.clear(board_->cols());
+    for(size_t row = i::subtract_floor_0(poi.row, kReduceRange);
+        row <= std::min(board_->rows() - 1, poi.row + kReduceRange);
+        ++row) {
+        
+        for(size_t col = i::subtract_floor_0(poi.col, kReduceRange);
+            col <= std::min(board_->cols() - 1, poi.col + kReduceRange);
+            ++col) {
+            
+	    Location l{row, col};
+	    if (!inWindow(l) or !board_->is_uncovered(l))
+		continue;
+	    
+	    auto info = getNeighborhoodInfo(l);
+	    if (info.nr)
+		reducer_.add(info.mines_nr, info.coveredUnmarkedLocations.data(), info.nr);
+	}
+    }
+    
+    deductions_.clear();
+    if (!reducer_.reduce(deductions_)) {
+	// wrong marks on the board; leave it to the LP
+	errlog << "inconsistent constraints around " << poi;
+	return true;
+    }
+    
+    for(auto& d: deductions_)
+	if (!applyDeduction(poi, d.location, d.mined))
+	    return false;
+    
+    return true;
+}
+
+
+bool Solver::applyDeduction(Location poi, Location l, bool mined) {
+    if (board_->field()->is_mined(l) != mined) {
+	xlog << "ERROR: calculated " << l
+	     << (mined ? " to contain a mine, but it doesn't" : " to be empty, but it has a mine")
+	     << "\npoi=" << poi << "\n";
+	board_->dump_region(poi, 3);
+	if (!mined)
+	    resultHandler_(FeedbackState::kGameLost, Location{}, 0);
+	return false;
+    }
+    
+    if (mined) {
+	board_->mark_mine(l, true);
+	addPoi(l);
+    } else if (!openSafe(l)) {
+	return true; // a zero region opened it already
+    }
+    
+    if (trace_)
+	trace_->record(mined ? SolverTrace::Event::kMine : SolverTrace::Event::kSafe, l);
+    return true;
+}
+
+
+bool Solver::solveGlobal(Location poi) {
+    auto left_nr = board_->left_nr();
+    if (windowed() or left_nr > globalThreshold_)
+	return true;
+    auto mines_nr = board_->field()->mines_nr();
+    auto marked_nr = board_->mines_marked();
+    if (!left_nr or mines_nr < marked_nr)
+	return true;
+    if (left_nr == globalIdle_)
+	return true; // resolved nothing on this board last time
+    
+    auto& m = global_;
+    m.constraints.clear();
+    board_->frontier(m.constraints);
+    m.infos.clear();
+    m.cells.clear(board_->cols());
+    for(auto& l: m.constraints) {
+	m.infos.push_back(getNeighborhoodInfo(l));
+	auto& info = m.infos.back();
+	for(uint8_t i = 0; i < info.nr; ++i)
+	    m.cells.emplace(info.coveredUnmarkedLocations[i], 1);
+    }
+    
+    if (m.cells.empty())
+	return true;
+    
+    ++globalStats_.solves;
+    m.mines_left = mines_nr - marked_nr;
+    m.rest_nr = left_nr - m.cells.size();
+    m.exhaustive = true;
+    if (!probeGlobal(poi, m))
+	return false;
+    
+    //
+    // all of the unconstrained cells might be safe (or mined) together
+    //
+    if (m.rest_nr) {
+	int mined = -1;
+	if (!globalRestBound(m, true))
+	    mined = 0;
+	else if (globalRestBound(m, false) >= m.rest_nr)
+	    mined = 1;
+    
+	if (mined >= 0) {
+	    unknown_.clear();
+	    board_->unknown(unknown_);
+	    for(auto& l: unknown_) {
+		// zero regions opened on the way may have taken it along
+		if (board_->at(l) != GameBoard::CellInfo::Unknown or m.cells.count(l))
+		    continue;
+    
+		if (!applyDeduction(poi, l, mined))
+		    return false;
+	    }
+	}
+    }
+    
+    globalStats_.resolved += left_nr - board_->left_nr();
+    if (board_->left_nr() == left_nr and m.exhaustive)
+	globalIdle_ = left_nr;
+    return true;
+}
+
+
+bool Solver::openSafe(Location l) {
+    if (board_->at(l) != GameBoard::CellInfo::Unknown)
+	return false;
+    
+    auto nearby = board_->field()->nearby_mines_nr(l);
+    board_->uncovered_safe(l, nearby);
+    if (nearby) {
+	addPoi(l);
+	return true;
+    }
+    
+    border_.clear();
+    auto area = windowed_ ? board_->open_zeros(l, border_, window_) : board_->open_zeros(l, border_);
+    for(auto& c: border_)
+	addPoi(c);
+    
+    // the region may be far larger than what a solved POI repaints
+    auto range = std::max(area.row1 - area.row0, area.col1 - area.col0) / 2 + 1;
+    if (range > kUpdateRange)
+	resultHandler_(FeedbackState::kSolved,
+		       {(area.row0 + area.row1) / 2, (area.col0 + area.col1) / 2}, range);
+    return true;
+}
+
+
+void Solver::collectComponents(Location poi, std::vector<std::vector<Location>>& out) {
+    out.clear();
+    if (!frontier_.sized())
+	frontier_.reset(board_->cols());
+    
+    // Register constraints around POI. Every board change is followed by
+    // addPoi() of the changed cell, so this keeps frontier_ up to date.
+    std::vector<Location> seeds;
+    for(size_t row = i::subtract_floor_0(poi.row, 1);
+        row <= std::min(board_->rows() - 1, poi.row + size_t{1});
+        ++row) {
+        
+        for(size_t col = i::subtract_floor_0(poi.col, 1);
+            col <= std::min(board_->cols() - 1, poi.col + size_t{1});
+            ++col) {
+            
+	    Location l{row, col};
+	    if (!inWindow(l) or !board_->is_uncovered(l))
+		continue;
+	    
+	    auto info = getNeighborhoodInfo(l);
+	    if (!info.nr)
+		continue;
+	    
+	    frontier_.add(l, info.coveredUnmarkedLocations.data(), info.nr);
+	    seeds.push_back(l);
+	}
+    }
+    
+    auto cells_of = [this](Location l, Location* cells) { return constraintCells(l, cells); };
+    auto collected = [&out](Location l) {
+	for(auto& o: out)
+	    if (std::find(o.begin(), o.end(), l) != o.end())
+		return true;
+	return false;
+    };
+    
+    for(auto& seed: seeds) {
+	if (collected(seed))
+	    continue;
+	
+	// Pull in constraints around the component's cells which weren't
+	// registered yet, and check whether any of its cells got resolved, in
+	// which case it might have split.
+	// Registering a constraint may merge in other components, so repeat
+	// until nothing new shows up, or the component turns out too large.
+	visited_.clear(board_->cols());
+	bool stale{}, grown{true}, large{};
+	while(grown) {
+	    grown = false;
+	    if (frontier_.component(seed).size() > kMaxComponentConstraints) {
+		large = true;
+		break;
+	    }
+	    
+	    auto work = frontier_.component(seed);
+	    for(auto& c: work) {
+		if (!visited_.emplace(c, 1))
+		    continue;
+		
+		Location cells[8];
+		auto nr = cells_of(c, cells);
+		if (nr < frontier_.cells_nr(c))
+		    stale = true;
+		
+		for(uint8_t k = 0; k < nr; ++k) {
+		    for(auto it = board_->neighborhood(cells[k]); it; ++it) {
+			if (!inWindow(*it) or !board_->is_uncovered(*it) or frontier_.contains(*it))
+			    continue;
+			
+			auto info = getNeighborhoodInfo(*it);
+			frontier_.add(*it, info.coveredUnmarkedLocations.data(), info.nr);
+			grown = true;
+		    }
+		}
+	    }
+	    
+	    grown = grown or frontier_.component(seed).size() != visited_.size();
+	}
+	
+	out.emplace_back();
+	if (large) {
+	    collectNearest(seed, out.back());
+	    continue;
+	}
+	
+	if (stale)
+	    frontier_.rebuild(seed, cells_of);
+	out.back() = frontier_.component(seed);
+    }
+}
+
+
+void Solver::collectNearest(Location seed, std::vector<Location>& out) {
+    // breadth first, so the constraints closest to seed are found first
+    visited_.clear(board_->cols());
+    visited_.emplace(seed, 1);
+    out.push_back(seed);
+    for(size_t i = 0; i < out.size(); ++i) {
+	Location cells[8];
+	auto nr = constraintCells(out[i], cells);
+	for(uint8_t k = 0; k < nr; ++k) {
+	    for(auto it = board_->neighborhood(cells[k]); it; ++it) {
+		if (!inWindow(*it) or !board_->is_uncovered(*it) or !visited_.emplace(*it, 1))
+		    continue;
+		
+		out.push_back(*it);
+		if (out.size() == kMaxComponentConstraints)
+		    return;
+	    }
+	}
+    }
+}
+
+
+uint8_t Solver::constraintCells(Location l, Location* cells) const {
+    // Constraints left outside of the window by setWindow() are dropped
+    // without reading their cells, which another solver may be writing.
+    if (!inWindow(l) or !board_->is_uncovered(l))
+	return 0;
+    
+    auto info = getNeighborhoodInfo(l);
+    std::copy(info.coveredUnmarkedLocations.begin(),
+              info.coveredUnmarkedLocations.begin() + info.nr, cells);
+    return info.nr;
+}
+
+
+bool Solver::getProbabilities(ProbabilityEngine::Result& result) {
+    constraints_.clear();
+    board_->frontier(constraints_);
+    
+    if (!stallFrontier_.sized())
+	stallFrontier_.reset(board_->cols());
+    for(auto& l: constraints_)
+	if (!stallFrontier_.contains(l)) {
+	    auto info = getNeighborhoodInfo(l);
+	    stallFrontier_.add(l, info.coveredUnmarkedLocations.data(), info.nr);
+	}
+    
+    // One group per component, which the engine keeps layouts of while its
+    // version stays. Cells only get resolved, so a constraint with as many
+    // unknown cells as when it was registered didn't change. A component
+    // with one which did, even if it's off the frontier by now, might have
+    // split, and is rebuilt.
+    auto cells_of = [this](Location l, Location* cells) {
+	auto info = getNeighborhoodInfo(l);
+	std::copy_n(info.coveredUnmarkedLocations.data(), info.nr, cells);
+	return info.nr;
+    };
+    auto changed = [&](Location c) {
+	Location cells[8];
+	return cells_of(c, cells) != stallFrontier_.cells_nr(c);
+    };
+    
+    probabilities_.clear(board_->cols());
+    grouped_.assign(stallFrontier_.nodes_nr(), 0);
+    for(auto& l: constraints_) {
+	if (grouped_[stallFrontier_.root(l)])
+	    continue;
+	
+	auto& members = stallFrontier_.component(l);
+	if (std::any_of(members.begin(), members.end(), changed))
+	    stallFrontier_.rebuild(l, cells_of);
+	
+	grouped_[stallFrontier_.root(l)] = 1;
+	if (!probabilities_.group(stallFrontier_.root(l), stallFrontier_.version(l)))
+	    continue;
+	
+	// in the frontier's order, which enumeration and estimates go by
+	group_ = stallFrontier_.component(l);
+	std::sort(group_.begin(), group_.end(), [](Location a, Location b) {
+		return a.row < b.row or (a.row == b.row and a.col < b.col);
+	    });
+	for(auto& c: group_) {
+	    auto info = getNeighborhoodInfo(c);
+	    probabilities_.add(info.mines_nr, info.coveredUnmarkedLocations.data(), info.nr);
+	}
+    }
+    
+    auto mines_nr = board_->field()->mines_nr();
+    auto marked_nr = board_->mines_marked();
+    auto mines_left = mines_nr > marked_nr ? mines_nr - marked_nr : 0;
+    return probabilities_.compute(mines_left, board_->left_nr() - probabilities_.cells_nr(), result);
+}
+
+
+bool Solver::popPoi(Location& poi) {
+    std::lock_guard<std::mutex> lock{queue_mtx_};
+    return poi_.pop(poi);
+}
+
+
+bool Solver::solvePoi(Location poi) {
+    if (!trace_)
+	return doPoi(poi);
+    
+    trace_->record(SolverTrace::Event::kPoi, poi);
+    auto lp_solves = lpSolves();
+    auto t0 = std::chrono::steady_clock::now();
+    auto rv = doPoi(poi);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0);
+    trace_->poi_done(poi, ns.count(), lpSolves() - lp_solves);
+    return rv;
+}
+
+
+bool Solver::solveQueued() {
+    Location poi;
+    while(popPoi(poi)) {
+	if (!solvePoi(poi))
+	    return false;
+	resultHandler_(FeedbackState::kSolved, poi, kUpdateRange);
+    }
+    
+    return true;
+}
+
+
 void Solver::asyncSolver() {
     while(okToRun()) {
         Location poi;
-        
-        {
-            std::unique_lock<std::mutex> lock{queue_mtx_};
-            if (poi_.empty()) {
-                lock.unlock();
-                state_ = RunState::kSuspended;
-                resultHandler_(FeedbackState::kSuspended, Location{}, 0);
-                continue;
-            }
-
-            poi = poi_.front();
-            poi_.pop_front();
+        if (!popPoi(poi)) {
+            setState(RunState::kSuspended);
+            resultHandler_(FeedbackState::kSuspended, Location{}, 0);
+            continue;
         }
         
-	if (!doPoi(poi)) {
-	    state_ = RunState::kExit;
+	if (!solvePoi(poi)) {
+	    setState(RunState::kExit);
 	    return;
 	}
 	
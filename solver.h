@@ -1,20 +1,30 @@
 #pragma once
 
 #include "board.h"
+#include "constraint_reducer.h"
+#include "frontier.h"
+#include "poi_scheduler.h"
+#include "probability.h"
+#include "solver_trace.h"
 
 namespace miner {
 
 class Solver {
     static constexpr const size_t kUpdateRange = 1;
-    enum class RunState : uint8_t {
-	kNew,
-	kRunning,
-	kSuspending,
-	kSuspended,
-	kExit,
-    };
+    // constraints whose centers are within this range share cells with
+    // constraints around POI's neighbors
+    static constexpr const size_t kReduceRange = 2;
+    // larger components are cut down to constraints closest to POI
+    static constexpr const size_t kMaxComponentConstraints = 256;
+    // frontier nodes kept across windows, in cells of the current one
+    static constexpr const size_t kFrontierWindows = 4;
+    
+    friend class ParallelSolver;
     
 public:
+    // default number of unknown cells left which turns global mode on
+    static constexpr const size_t kGlobalThreshold = 256;
+    
     enum FeedbackState : uint8_t {
 	kSolved,
 	kSuspended,
@@ -23,38 +33,178 @@ public:
     
     using ResultHandler = std::function<void(FeedbackState,Location,size_t)>;
     
+    struct NeighborhoodInfo {
+        uint8_t mines_nr{}; // number of mines left around current cell
+        uint8_t nr{};       // size of "coveredUnmarkedLocations" array
+        std::array<Location, 8> coveredUnmarkedLocations;
+    };
+    
     explicit Solver(GameBoardPtr board) : board_{board} {}
     virtual ~Solver();
     
     bool isRunning() const;
     void startAsync();
     void suspend();
+    // Suspends and waits until the solver thread has let go of the board.
+    // Returns whether it was running, so that it can be resume()d after.
+    bool suspendAndWait();
     void resume();
     void stop();
-    void addPoi(Location);
+    virtual void addPoi(Location);
     void setResultHandler(ResultHandler h) { resultHandler_ = h; }
     
+    // Limits solving to constraints whose whole neighborhood is inside the
+    // window, so that no cell outside of it is read or written. This lets
+    // several solvers work on disjoint windows of one board.
+    using Window = GameBoard::Area;
+    void setWindow(const Window&);
+    
+    // Sends deduced cells to parent's addPoi() instead of own queue.
+    void setParent(Solver* p) { parent_ = p; }
+    
+    // Records solved POIs and deduced cells in the trace.
+    virtual void setTrace(SolverTracePtr t) { trace_ = std::move(t); }
+    
+    // Solves a POI on the calling thread as if it had been popped from the
+    // queue, e.g. to replay a trace. Returns false if game is lost.
+    bool solvePoi(Location);
+    
+    // Mine probabilities of unknown cells, e.g. to pick a guess once solver
+    // is stuck. Components of the frontier which didn't change since the
+    // last call aren't enumerated again. Returns false if board's numbers
+    // contradict each other.
+    bool getProbabilities(ProbabilityEngine::Result&);
+    
+    // Solves queued POIs and everything they lead to on the calling thread,
+    // for running without startAsync(). Returns false if game is lost.
+    virtual bool solveQueued();
+    
+    // LPs solved so far, or SAT problems by the exact backend, for reports;
+    // 0 for solvers without either.
+    virtual size_t lpSolves() const { return 0; }
+    virtual PoiScheduler::Stats poiStats() const;
+    
+    struct GlobalStats {
+	size_t solves{};
+	size_t resolved{}; // cells resolved in global mode only
+    };
+    
+    // With this few unknown cells left, every POI is followed by a solve over
+    // the whole frontier and the total number of mines left (see
+    // solveGlobal()); 0 turns global mode off.
+    void setGlobalThreshold(size_t v) { globalThreshold_ = v; }
+    const GlobalStats& globalStats() const { return globalStats_; }
+    
 protected:
+    enum class RunState : uint8_t {
+	kNew,
+	kRunning,
+	kSuspending,
+	kSuspended,
+	kExit,
+    };
+    
     virtual bool doPoi(miner::Location) = 0;
+    virtual void asyncSolver();
+    // called when setWindow() moves the window; state kept between POIs
+    // must stop reading cells outside of it
+    virtual void windowChanged() {}
+    bool okToRun();
+    void setState(RunState); // by the solver thread, wakes suspendAndWait()
+    bool popPoi(Location&);
+    
+    bool windowed() const { return windowed_; }
+    bool inWindow(Location constraint) const;
     
-    struct NeighborhoodInfo {
-        uint8_t mines_nr{}; // number of mines left around current cell
-        uint8_t nr{};       // size of "coveredUnmarkedLocations" array
-        std::array<Location, 8> coveredUnmarkedLocations;
-    };
     NeighborhoodInfo getNeighborhoodInfo(Location) const;
     
+    // Resolves cells forced by single or pairs of constraints around POI (see
+    // ConstraintReducer) without solving an LP. Returns false if game is lost.
+    bool reduce(Location poi);
+    
+    // Checks a deduced cell against the field and applies it to the board.
+    bool applyDeduction(Location poi, Location, bool mined);
+    
+    // Uncovers a safe cell, unless a zero region opened it already, and
+    // queues it. A N0 cell opens its whole zero region at once (see
+    // GameBoard::open_zeros), inside the window, and only the region's
+    // border is queued. Returns false if the cell was uncovered already.
+    bool openSafe(Location);
+    
+    // Collects constraints of every frontier component touching POI, one
+    // list per component. Components larger than kMaxComponentConstraints
+    // are cut down to the constraints closest to POI (see collectNearest()).
+    void collectComponents(Location poi, std::vector<std::vector<Location>>&);
+    
+    // Appends up to kMaxComponentConstraints constraints of seed's component,
+    // the closest through shared cells first, without reading any further.
+    void collectNearest(Location seed, std::vector<Location>&);
+    
+    // Stores current unknown cells of a constraint and returns their number,
+    // zero if it's resolved or outside of the window.
+    uint8_t constraintCells(Location, Location* cells) const;
+    
+    // Every frontier constraint and the number of mines left over all unknown
+    // cells, where the cells no constraint covers are taken together as the
+    // "rest", for backends to model in global mode.
+    struct GlobalModel {
+	std::vector<Location> constraints;
+	std::vector<NeighborhoodInfo> infos; // of each constraint
+	CellMap<uint8_t> cells;              // unknown cells of infos
+	size_t mines_left{};
+	size_t rest_nr{};
+	bool exhaustive{}; // cleared by a backend which gave up on some cell
+    };
+    
+    // Near the end of the game, the number of mines left may resolve what
+    // components can't: with globalThreshold_ unknown cells left and no
+    // window, solves the GlobalModel with probeGlobal() and then resolves the
+    // rest when all of it is safe or mined (see globalRestBound()). Returns
+    // false if game is lost.
+    bool solveGlobal(Location poi);
+    
+    // Sets the backend's model up over the GlobalModel, with the rest as a
+    // single unknown taking up to rest_nr mines, and resolves its cells as
+    // components' ones. Returns false if game is lost.
+    virtual bool probeGlobal(Location /*poi*/, GlobalModel&) { return true; }
+    
+    // Most (or, with !maximize, fewest) mines the rest takes in solutions of
+    // the model probeGlobal() has set up, or a bound on it past which the
+    // backend can't tell.
+    virtual size_t globalRestBound(GlobalModel& m, bool maximize) { return maximize ? m.rest_nr : 0; }
+    
     GameBoardPtr board_;
+    SolverTracePtr trace_;
     ResultHandler resultHandler_;
+    std::atomic<RunState> state_{RunState::kNew};
     
 private:
-    bool okToRun();
-    void asyncSolver();
+    Solver* parent_{};
+    Window window_{};
+    bool windowed_{};
     
-    std::atomic<RunState> state_{RunState::kNew};
+    ConstraintReducer reducer_;
+    std::vector<ConstraintReducer::Deduction> deductions_;
+    FrontierComponents frontier_;
+    CellMap<uint8_t> visited_; // constraints, by collectComponents()
+    std::vector<Location> border_; // of a zero region, by openSafe()
+    ProbabilityEngine probabilities_;
+    FrontierComponents stallFrontier_; // whole frontier, by getProbabilities()
+    std::vector<uint8_t> grouped_;     // by root, by getProbabilities()
+    std::vector<Location> group_;      // constraints of one, by getProbabilities()
+    std::vector<Location> constraints_;
+    GlobalModel global_;
+    std::vector<Location> unknown_; // by solveGlobal()
+    size_t globalThreshold_{kGlobalThreshold};
+    // left_nr() of the board solveGlobal() last resolved nothing on; as cells
+    // only get resolved, solving it again is pointless until left_nr() changes.
+    // Zero regions open at once, so the end of the game, when every POI is
+    // followed by a global solve, is reached with many POIs still queued.
+    size_t globalIdle_{size_t(-1)};
+    GlobalStats globalStats_;
 
-    std::mutex queue_mtx_;     // used to protect queue access
-    std::deque<Location> poi_; // a list of cells of interest
+    mutable std::mutex queue_mtx_; // used to protect queue access
+    PoiScheduler poi_;             // cells of interest
     
     std::thread thread_;
     std::mutex mtx_;
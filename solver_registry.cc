@@ -0,0 +1,73 @@
+#include "solver_registry.h"
+#include "parallel_solver.h"
+#include "sat_solver.h"
+#include "simplex_solver.h"
+
+#if ENABLE_GLPK_SOLVER
+#include "glpk_solver.h"
+#endif
+
+#if ENABLE_SOPLEX_SOLVER
+#include "soplex_solver.h"
+#endif
+
+namespace miner {
+
+namespace {
+
+template<class S>
+std::unique_ptr<Solver> make(GameBoardPtr board) {
+    return std::unique_ptr<Solver>(new S{board});
+}
+
+} // namespace
+
+
+const std::vector<SolverRegistry::Backend>& SolverRegistry::backends() {
+    static const std::vector<Backend> rv{
+#if ENABLE_SOPLEX_SOLVER
+	{"soplex", "LP on SoPlex", make<SoplexSolver>},
+#endif
+#if ENABLE_GLPK_SOLVER
+	{"glpk", "LP on GLPK", make<GlpkSolver>},
+#endif
+	{"simplex", "LP on the built-in simplex", make<SimplexSolver>},
+	{"sat", "exact, on the built-in cardinality SAT solver", make<SatSolver>},
+    };
+    return rv;
+}
+
+
+const SolverRegistry::Backend* SolverRegistry::find(const std::string& name) {
+    for(auto& b: backends())
+	if (name == b.name)
+	    return &b;
+    return nullptr;
+}
+
+
+const SolverRegistry::Backend& SolverRegistry::preferred() {
+    if (auto name = getenv("MINER_SOLVER")) {
+	if (auto b = find(name))
+	    return *b;
+	errlog << "unknown MINER_SOLVER " << name << ", expected one of " << names();
+    }
+    return backends().front();
+}
+
+
+std::string SolverRegistry::names() {
+    std::string rv;
+    for(auto& b: backends())
+	rv += (rv.empty() ? "" : ",") + std::string(b.name);
+    return rv;
+}
+
+
+std::unique_ptr<Solver> SolverRegistry::create(const Backend& b, GameBoardPtr board, size_t threads) {
+    if (threads > 1 and ParallelSolver::worthIt(*board))
+	return std::unique_ptr<Solver>(new ParallelSolver{board, b.create, threads});
+    return b.create(board);
+}
+
+} // namespace miner
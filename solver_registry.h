@@ -0,0 +1,36 @@
+#pragma once
+
+#include "solver.h"
+
+namespace miner {
+
+//
+// Solver backends compiled into the binary, by name, so that one binary can
+// pick any of them at run time: from the UI, a --solver option or the
+// MINER_SOLVER environment variable.
+//
+class SolverRegistry {
+public:
+    using Factory = std::function<std::unique_ptr<Solver>(GameBoardPtr)>;
+    
+    struct Backend {
+	const char* name;
+	const char* description;
+	Factory create;
+    };
+    
+    // every compiled-in backend, preferred ones first
+    static const std::vector<Backend>& backends();
+    // nullptr if no backend has this name
+    static const Backend* find(const std::string& name);
+    // the one MINER_SOLVER names if it is set, else the first one
+    static const Backend& preferred();
+    // comma separated names, for usage messages
+    static std::string names();
+    
+    // Backend's solver for board; ParallelSolver running it on up to
+    // "threads" workers if board is large enough for that to pay off.
+    static std::unique_ptr<Solver> create(const Backend&, GameBoardPtr, size_t threads = 1);
+};
+
+} // namespace miner
@@ -0,0 +1,171 @@
+#include "solver_trace.h"
+
+namespace miner {
+
+namespace {
+
+const char kMagic[8] = {'M', 'I', 'N', 'E', 'R', 'T', 'R', 'C'};
+constexpr uint8_t kLastEvent = uint8_t(SolverTrace::Event::kBackend);
+
+uint64_t zigzag(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+int64_t unzigzag(uint64_t v) { return int64_t(v >> 1) ^ -int64_t(v & 1); }
+
+} // namespace
+
+
+SolverTrace::SolverTrace(const std::string& path, const Field& field, const std::string& backend)
+    : path_{path} {
+    file_ = fopen(path.c_str(), "wb");
+    I_ASSERT(file_, EX_LOG("can't create " << path << ": " << strerror(errno)));
+    setvbuf(file_, nullptr, _IOFBF, 1 << 16);
+
+    fwrite(kMagic, sizeof(kMagic), 1, file_);
+    write_varint(kVersion);
+    write_varint(field.rows());
+    write_varint(field.cols());
+    write_varint(field.mines_nr());
+    write_varint(zigzag(field.seed()));
+    write_varint(field.lazy());
+    write_varint(backend.size());
+    fwrite(backend.data(), 1, backend.size(), file_);
+}
+
+
+SolverTrace::~SolverTrace() {
+    if (fclose(file_))
+        errlog << "can't write " << path_ << ": " << strerror(errno);
+}
+
+
+void SolverTrace::write_varint(uint64_t v) {
+    uint8_t buf[10];
+    size_t n = 0;
+    for(; v >= 0x80; v >>= 7)
+        buf[n++] = uint8_t(v) | 0x80;
+    buf[n++] = uint8_t(v);
+    fwrite(buf, 1, n, file_);
+}
+
+
+void SolverTrace::write(Event e, Location l) {
+    putc(uint8_t(e), file_);
+    write_varint(zigzag(int64_t(l.row) - last_.row));
+    write_varint(zigzag(int64_t(l.col) - last_.col));
+    last_ = l;
+}
+
+
+void SolverTrace::record(Event e, Location l) {
+    std::lock_guard<std::mutex> lock{mtx_};
+    write(e, l);
+}
+
+
+void SolverTrace::record_move(const GameBoard& board, Location l) {
+    switch(board.at(l)) {
+    case GameBoard::CellInfo::Exploded:
+        return record(Event::kExplode, l);
+    case GameBoard::CellInfo::MarkedMine:
+        return record(Event::kMark, l);
+    case GameBoard::CellInfo::Unknown:
+        return record(Event::kUnmark, l);
+    default:
+        return record(Event::kOpen, l);
+    }
+}
+
+
+void SolverTrace::poi_done(Location l, uint64_t ns, uint64_t lp_solves) {
+    std::lock_guard<std::mutex> lock{mtx_};
+    write(Event::kPoiDone, l);
+    write_varint(ns);
+    write_varint(lp_solves);
+}
+
+
+// Keeps the location of the previous record, which is a zero delta.
+void SolverTrace::backend_changed(const std::string& backend) {
+    std::lock_guard<std::mutex> lock{mtx_};
+    write(Event::kBackend, last_);
+    write_varint(backend.size());
+    fwrite(backend.data(), 1, backend.size(), file_);
+}
+
+
+void SolverTrace::flush() {
+    std::lock_guard<std::mutex> lock{mtx_};
+    fflush(file_);
+}
+
+
+SolverTrace::Reader::Reader(const std::string& path) : path_{path} {
+    file_ = fopen(path.c_str(), "rb");
+    I_ASSERT(file_, EX_LOG("can't open " << path << ": " << strerror(errno)));
+    setvbuf(file_, nullptr, _IOFBF, 1 << 16);
+
+    char magic[sizeof(kMagic)];
+    if (fread(magic, sizeof(magic), 1, file_) != 1 or memcmp(magic, kMagic, sizeof(kMagic))) {
+        fclose(file_);
+        I_FAIL(path << " is not a solver trace");
+    }
+
+    try {
+        auto version = read_varint();
+        I_ASSERT(version <= kVersion,
+                 EX_LOG(path << " has trace version " << version << ", newer than " << kVersion));
+        header_.rows = read_varint();
+        header_.cols = read_varint();
+        header_.mines_nr = read_varint();
+        header_.seed = unzigzag(read_varint());
+        header_.lazy = read_varint();
+        header_.backend.resize(read_varint());
+        I_ASSERT(fread(&header_.backend[0], 1, header_.backend.size(), file_) == header_.backend.size(),
+                 EX_LOG(path << " is truncated"));
+    } catch(...) {
+        fclose(file_);
+        throw;
+    }
+}
+
+
+SolverTrace::Reader::~Reader() {
+    fclose(file_);
+}
+
+
+uint64_t SolverTrace::Reader::read_varint() {
+    uint64_t rv = 0;
+    for(unsigned shift = 0; shift < 64; shift += 7) {
+        auto c = getc(file_);
+        I_ASSERT(c != EOF, EX_LOG(path_ << " is truncated"));
+        rv |= uint64_t(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return rv;
+    }
+    I_FAIL(path_ << " has a bad varint");
+}
+
+
+bool SolverTrace::Reader::next(Record& r) {
+    auto e = getc(file_);
+    if (e == EOF)
+        return false;
+    I_ASSERT(e <= kLastEvent, EX_LOG(path_ << " has an unknown event " << e));
+
+    r.event = Event(e);
+    r.location = {size_t(last_.row + unzigzag(read_varint())), size_t(last_.col + unzigzag(read_varint()))};
+    last_ = r.location;
+    r.ns = r.lp_solves = 0;
+    r.backend.clear();
+    if (r.event == Event::kPoiDone) {
+        r.ns = read_varint();
+        r.lp_solves = read_varint();
+    } else if (r.event == Event::kBackend) {
+        r.backend.resize(read_varint());
+        I_ASSERT(fread(&r.backend[0], 1, r.backend.size(), file_) == r.backend.size(),
+                 EX_LOG(path_ << " is truncated"));
+    }
+    return true;
+}
+
+} // namespace miner
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "board.h"
+
+namespace miner {
+
+//
+// Compact binary trace of a game, for replaying it (see replay.cc): the field
+// it was played on, the player's moves, every POI queued for the solver and
+// every one it solved, with the cells it deduced, the LPs it solved and how
+// long it took, and the backends the game switched to.
+// Records are appended under a mutex, so their order is the order in which
+// the UI and solver threads actually interleaved. Locations are stored as
+// varint deltas from the previous record's, which are mostly small.
+//
+class SolverTrace {
+public:
+    static constexpr uint32_t kVersion = 2; // 2: kAddPoi, kBackend
+
+    enum class Event : uint8_t {
+        kOpen,    // player opened a safe cell
+        kExplode, // player opened a mine
+        kMark,    // player marked a mine
+        kUnmark,
+        kPoi,     // solver started on a POI
+        kSafe,    // solver deduced a safe cell
+        kMine,    // solver deduced a mine
+        kPoiDone, // solver finished a POI
+        kAddPoi,  // POI queued for the solver
+        kBackend, // game switched to another solver
+    };
+
+    struct Header {
+        size_t rows{}, cols{}, mines_nr{};
+        long seed{};
+        bool lazy{};         // field of Field::gen_lazy(), else of gen_random()
+        std::string backend; // solver's, see SolverRegistry
+    };
+
+    struct Record {
+        Event event{};
+        Location location;
+        uint64_t ns{};         // time spent on the POI, for kPoiDone
+        uint64_t lp_solves{};  // LP or SAT solves for the POI, for kPoiDone
+        std::string backend;   // for kBackend
+    };
+
+    // Starts a trace of a game on a generated field. Throws i::exception.
+    SolverTrace(const std::string& path, const Field&, const std::string& backend);
+    ~SolverTrace();
+
+    void record(Event, Location);
+    void record_move(const GameBoard&, Location); // by the cell's state after the move
+    void poi_done(Location, uint64_t ns, uint64_t lp_solves);
+    void backend_changed(const std::string&);
+    void flush();
+
+    class Reader {
+    public:
+        explicit Reader(const std::string& path); // throws i::exception
+        ~Reader();
+
+        const Header& header() const { return header_; }
+        bool next(Record&); // false at the end of the trace
+
+    private:
+        uint64_t read_varint();
+
+        FILE* file_{};
+        std::string path_;
+        Header header_;
+        Location last_;
+    };
+
+private:
+    void write(Event, Location);
+    void write_varint(uint64_t);
+
+    std::mutex mtx_;
+    FILE* file_{};
+    std::string path_;
+    Location last_; // of the previous record
+};
+
+using SolverTracePtr = std::shared_ptr<SolverTrace>;
+
+} // namespace miner
@@ -5,11 +5,225 @@
 
 namespace miner {
 
+struct SoplexSolver::Model {
+    soplex::SoPlex spx;
+    std::vector<soplex::Real> primal;
+    size_t cols{};
+    bool boundsChanged{}; // since the last solve; the basis stays dual feasible
+    
+    Model() {
+	spx.setIntParam(soplex::SoPlex::VERBOSITY, soplex::SoPlex::VERBOSITY_ERROR);
+    }
+    
+    void clear() {
+	spx.clearLPReal();
+	cols = 0;
+	boundsChanged = false;
+    }
+    
+    void addColumn(double upper) {
+	soplex::DSVector empty(0);
+	spx.addColReal(soplex::LPCol(0, empty, upper, 0));
+	++cols;
+    }
+    
+    template<class F>
+    void addRow(double value, size_t nr, F&& column) {
+	soplex::DSVector row{int(nr)};
+	for(size_t i = 0; i < nr; ++i)
+	    row.add(int(column(i)), 1);
+	spx.addRowReal(soplex::LPRow(value, row, value));
+    }
+};
+
+
+SoplexSolver::SoplexSolver(GameBoardPtr board)
+    : Solver{board}, model_{new Model} {
+}
+
+
+SoplexSolver::~SoplexSolver() {
+}
+
+
 bool SoplexSolver::doPoi(Location poi) {
+    if (board_->is_uncovered(poi)) {
+	auto pois = getNeighborhoodInfo(poi);
+	if (!pois.nr)
+	    return true;
+    }
+    
+    // common patterns don't need an LP
+    if (!reduce(poi))
+	return false;
+    
+    if (board_->is_uncovered(poi)) {
+	auto pois = getNeighborhoodInfo(poi);
+	if (!pois.nr)
+	    return true;
+    }
+    
+    // one LP per frontier component
+    collectComponents(poi, components_);
+    for(auto& constraints: components_)
+	if (!solveComponent(poi, constraints))
+	    return false;
+    
+    // near the end, the number of mines left may resolve what components can't
+    if (!solveGlobal(poi))
+	return false;
+    
+    return true;
+}
+
+
+void SoplexSolver::build() {
+    cells_.clear();
+    columns_.clear(board_->cols());
+    for(auto& info: infos_)
+	for(uint8_t i = 0; i < info.nr; ++i)
+	    if (columns_.emplace(info.coveredUnmarkedLocations[i], cells_.size()))
+		cells_.push_back(info.coveredUnmarkedLocations[i]);
+    
+    auto& m = *model_;
+    m.clear();
+    for(size_t c = 0; c < cells_.size(); ++c)
+	m.addColumn(1);
+    
+    for(auto& info: infos_)
+	if (info.nr)
+	    m.addRow(info.mines_nr, info.nr, [&](size_t i) {
+		    return columns_.find(info.coveredUnmarkedLocations[i]);
+		});
+}
+
+
+bool SoplexSolver::solveComponent(Location poi, const std::vector<Location>& constraints) {
+    infos_.clear();
+    for(auto& l: constraints)
+	infos_.push_back(board_->is_uncovered(l) ? getNeighborhoodInfo(l) : NeighborhoodInfo{});
+    
+    build();
+    if (cells_.empty())
+	return true;
+    
+    return probe(poi);
+}
+
 
-    //TODO
+bool SoplexSolver::solve() {
+    auto& m = *model_;
+    m.spx.setIntParam(soplex::SoPlex::ALGORITHM, m.boundsChanged
+                      ? soplex::SoPlex::ALGORITHM_DUAL
+                      : soplex::SoPlex::ALGORITHM_PRIMAL);
+    m.boundsChanged = false;
     
+    auto status = m.spx.optimize();
+    ++stats_.lp_solves;
+    stats_.simplex_iterations += m.spx.numIterations();
+    if (status != soplex::SPxSolver::OPTIMAL)
+	return false;
+    
+    // Every solution is a witness: a column seen at 0 can't be a mine, one
+    // seen at 1 can't be safe, so probing for those is pointless.
+    m.primal.resize(m.cols);
+    if (!m.spx.getPrimalReal(m.primal.data(), int(m.cols)))
+	return false;
+    for(size_t c = 0; c < cells_.size(); ++c) {
+	auto x = m.primal[c];
+	witnesses_[c] |= (x < kEpsilon ? kSeenSafe : 0) | (x > 1 - kEpsilon ? kSeenMined : 0);
+    }
+    
+    return true;
 }
 
 
+double SoplexSolver::optimize(size_t col, bool maximize) {
+    auto& m = *model_;
+    m.spx.changeObjReal(int(col), 1);
+    m.spx.setIntParam(soplex::SoPlex::OBJSENSE, maximize
+                      ? soplex::SoPlex::OBJSENSE_MAXIMIZE
+                      : soplex::SoPlex::OBJSENSE_MINIMIZE);
+    
+    // without an optimum, nothing can be deduced
+    double rv = maximize ? m.cols : 0;
+    if (solve())
+	rv = m.spx.objValueReal();
+    
+    m.spx.changeObjReal(int(col), 0);
+    return rv;
+}
+
+
+void SoplexSolver::fix(size_t col, double v) {
+    auto& m = *model_;
+    m.spx.changeBoundsReal(int(col), v, v);
+    m.boundsChanged = true;
+    solve();
+}
+
+
+bool SoplexSolver::probe(Location poi) {
+    witnesses_.assign(cells_.size(), 0);
+    if (!solve()) {
+	errlog << "ERROR: could not solve LP around " << poi;
+	board_->dump_region(poi, kRange);
+	return true;
+    }
+    
+    for(size_t c = 0; c < cells_.size(); ++c) {
+	auto& seen = witnesses_[c];
+	if (seen == (kSeenSafe | kSeenMined)) {
+	    stats_.probes_skipped += 2;
+	    continue;
+	}
+	
+	auto hi = 1.;
+	if (seen & kSeenMined)
+	    ++stats_.probes_skipped;
+	else
+	    hi = optimize(c, true);
+	
+	int mined = -1;
+	if (hi <= 1 - kEpsilon) {
+	    mined = 0; // can't have a mine here
+	} else if (seen & kSeenSafe) {
+	    ++stats_.probes_skipped;
+	} else if (optimize(c, false) >= kEpsilon) {
+	    mined = 1; // must have a mine here
+	}
+	
+	if (mined < 0)
+	    continue;
+	
+	if (!applyDeduction(poi, cells_[c], mined))
+	    return false;
+	fix(c, mined);
+    }
+    
+    return true;
+}
+
+
+bool SoplexSolver::probeGlobal(Location poi, GlobalModel& gm) {
+    //
+    // every frontier constraint, plus a row summing all unknown cells up to
+    // the number of mines left; the rest is a single column
+    //
+    infos_.assign(gm.infos.begin(), gm.infos.end());
+    build();
+    auto& m = *model_;
+    if (gm.rest_nr)
+	m.addColumn(gm.rest_nr);
+    m.addRow(gm.mines_left, m.cols, [](size_t i) { return i; });
+    
+    return probe(poi);
+}
+
+
+size_t SoplexSolver::globalRestBound(GlobalModel&, bool maximize) {
+    auto v = optimize(cells_.size(), maximize);
+    return maximize ? size_t(std::floor(v + kEpsilon)) : size_t(std::ceil(v - kEpsilon));
+}
+
 } // namespace miner
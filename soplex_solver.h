@@ -1,17 +1,63 @@
 #pragma once
 
+#include "cell_map.h"
 #include "solver.h"
 
 namespace miner {
 
+//
+// LP-based solver on SoPlex. Makes the same deductions as GlpkSolver, but
+// keeps a single SoPlex instance: each component's LP is loaded into it, and
+// probes only change objective coefficients, sense and bounds in place, so
+// SoPlex re-optimizes from the previous basis (with the dual simplex after
+// bound changes, with the primal one otherwise).
+//
 class SoplexSolver : public Solver {
 public:
     static constexpr float kEpsilon = 1e-3;
     static constexpr size_t kRange = 7;
-    using Solver::Solver;
     
-private:
+    explicit SoplexSolver(GameBoardPtr);
+    ~SoplexSolver() override;
+    
+    struct Stats {
+	size_t lp_solves{};
+	size_t simplex_iterations{};
+	size_t probes_skipped{}; // max/min solves avoided thanks to witnesses
+    };
+    
+    const Stats& stats() const { return stats_; }
+    size_t lpSolves() const override { return stats_.lp_solves; }
+    
+protected:
+    struct Model; // wraps SoPlex, which stays out of this header
+    
+    enum : uint8_t {
+	kSeenSafe = 1,
+	kSeenMined = 2,
+    };
+    
     bool doPoi(Location) override;
+    // loads a row per constraint of infos_ over a column per cell
+    void build();
+    bool solveComponent(Location poi, const std::vector<Location>& constraints);
+    bool probeGlobal(Location poi, GlobalModel&) override;
+    size_t globalRestBound(GlobalModel&, bool maximize) override;
+    // finds cells_ which are forced to be safe or mined
+    bool probe(Location poi);
+    // re-optimizes from the current basis and records witnesses
+    bool solve();
+    // largest or smallest value of column "col"
+    double optimize(size_t col, bool maximize);
+    void fix(size_t col, double v);
+    
+    std::unique_ptr<Model> model_;
+    std::vector<std::vector<Location>> components_;
+    std::vector<NeighborhoodInfo> infos_;
+    std::vector<Location> cells_;                  // LP column -> cell
+    CellMap<uint32_t> columns_;                    // cell -> LP column
+    std::vector<uint8_t> witnesses_;               // kSeen* values seen per column
+    Stats stats_;
 };
 
 } // namespace miner
@@ -1,19 +1,26 @@
 #ifndef __I_STABLE_H_
 #define __I_STABLE_H_
 
+#if ENABLE_GLPK_SOLVER
 #include <glpk.h>
+#endif
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <deque>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <chrono>
+#include <functional>
 
 #include <QtCore>
 #include <QtWidgets>